@@ -0,0 +1,332 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <set>
+#include <map>
+#include <memory>
+#include <functional>
+#include <glob.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/sinks/basic_file_sink.h>
+#include <spdlog/details/null_mutex.h>
+#include "check_reducibility.hpp"
+#include "thread_pool.hpp"
+#include "job_queue.hpp"
+#include "conf_bundle.hpp"
+#include "duality.hpp"
+
+using std::string;
+using std::vector;
+
+// ログを、そのスレッドが処理中の configuration のログファイルに振り分ける sink
+// ログファイルが設定されていないスレッド (configuration の内部で使うワーカースレッドなど) のログは元の出力先に出す
+class RoutingSink : public spdlog::sinks::base_sink<spdlog::details::null_mutex> {
+    vector<spdlog::sink_ptr> fallback;
+    static inline thread_local spdlog::sink_ptr current;
+public:
+    explicit RoutingSink(vector<spdlog::sink_ptr> fallback) : fallback(std::move(fallback)) {}
+    // デフォルトの logger の出力先を RoutingSink に置き換える (一度だけ)
+    static void Install() {
+        auto& sinks = spdlog::default_logger()->sinks();
+        if (sinks.size() == 1 && std::dynamic_pointer_cast<RoutingSink>(sinks[0])) return;
+        auto router = std::make_shared<RoutingSink>(sinks);
+        sinks = {router};
+    }
+    // このスレッドのログの出力先を fileName (または sink) にする (スコープを抜けると元に戻る)
+    class Scope {
+        spdlog::sink_ptr previous;
+    public:
+        explicit Scope(const string& fileName) : Scope(std::make_shared<spdlog::sinks::basic_file_sink_mt>(fileName, true)) {}
+        explicit Scope(spdlog::sink_ptr sink) : previous(current) {
+            current = std::move(sink);
+        }
+        ~Scope() {
+            current->flush();
+            current = previous;
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override {
+        if (current) {
+            current->log(msg);
+            return;
+        }
+        for (auto& sink : fallback) {
+            if (sink->should_log(msg.level)) sink->log(msg);
+        }
+    }
+    void flush_() override {
+        if (current) current->flush();
+        for (auto& sink : fallback) sink->flush();
+    }
+};
+
+// -i に渡されたものが複数の configuration を表すか (ディレクトリ、ワイルドカード、.list ファイル、.bundle ファイル)
+bool IsBatchInput(const string& input) {
+    return input.find_first_of("*?[") != string::npos
+        || std::filesystem::is_directory(input)
+        || std::filesystem::path(input).extension() == ".list"
+        || std::filesystem::path(input).extension() == ".bundle";
+}
+
+// -i に渡されたものを configuration のファイルの一覧に展開する
+// ディレクトリならその中の拡張子 extension のファイル、ワイルドカードなら一致するファイル、.list ファイルなら各行に書かれたファイル
+vector<string> ExpandInputs(const string& input, const string& extension) {
+    vector<string> files;
+    if (input.find_first_of("*?[") != string::npos) {
+        glob_t result;
+        if (glob(input.c_str(), 0, nullptr, &result) == 0) {
+            for (size_t i = 0; i < result.gl_pathc; i++) {
+                files.push_back(result.gl_pathv[i]);
+            }
+        }
+        globfree(&result);
+    }
+    else if (std::filesystem::is_directory(input)) {
+        for (auto& entry : std::filesystem::directory_iterator(input)) {
+            if (entry.is_regular_file() && entry.path().extension() == extension) {
+                files.push_back(entry.path().string());
+            }
+        }
+    }
+    else if (std::filesystem::path(input).extension() == ".list") {
+        std::ifstream ifs(input);
+        if (!ifs) {
+            spdlog::error("Failed to read {}", input);
+            return {};
+        }
+        string line;
+        while (std::getline(ifs, line)) {
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            if (line.empty() || line[0] == '#') continue;
+            files.push_back(line);
+        }
+        return files;
+    }
+    else {
+        files.push_back(input);
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// ファイルの先頭行から configuration の大きさ (リングの大きさ, 頂点数) を読む (読めない場合は {0, 0})
+pair<int, int> ConfSizeOf(const string& fileName, bool isAnnular) {
+    std::ifstream ifs(fileName);
+    int vertexSize = 0, ringSize = 0, rightSize = 0;
+    ifs >> vertexSize >> ringSize;
+    if (isAnnular) {
+        ifs >> rightSize;
+        ringSize += rightSize;
+    }
+    if (!ifs) return {0, 0};
+    return {ringSize, vertexSize};
+}
+
+// 予算を使い切って中断した configuration があった場合の終了コード (スケジューラが大きいノードで再投入するのに使う)
+constexpr int overBudgetExitCode = 3;
+
+bool IsOverBudget(const vector<ReducibilityResult>& results) {
+    return std::any_of(results.begin(), results.end(), [](const ReducibilityResult& result) { return result.budgetExceeded; });
+}
+
+// バッチで判定する 1 つの configuration
+struct BatchItem {
+    string name; // ログの名前 (拡張子を除いたファイル名、bundle の場合は configuration の名前)
+    string label; // コンソールに表示する名前
+    pair<int, int> size; // (リングの大きさ, 頂点数)
+    std::function<vector<ReducibilityResult>(const EvaluateOptions&)> evaluate;
+};
+
+// ファイルの一覧を BatchItem の一覧にする (.bundle ファイルはその中の configuration に展開する)
+vector<BatchItem> BatchItemsOf(const vector<string>& files, bool isAnnular) {
+    vector<BatchItem> items;
+    for (auto& fileName : files) {
+        if (std::filesystem::path(fileName).extension() == ".bundle") {
+            auto bundle = std::make_shared<ConfBundle>(fileName);
+            for (size_t i = 0; i < bundle->size(); i++) {
+                auto name = bundle->Name(i);
+                items.push_back({name, fileName + ":" + name, bundle->SizeOf(i), [bundle, i, isAnnular](const EvaluateOptions& options) {
+                    if (isAnnular) {
+                        return EvaluateConfFrom<AnnularCubicConf>([&] { return bundle->Load<AnnularCubicConf>(i); }, options);
+                    }
+                    return EvaluateConfFrom<CubicConf>([&] { return bundle->Load<CubicConf>(i); }, options);
+                }});
+            }
+            continue;
+        }
+        items.push_back({std::filesystem::path(fileName).stem().string(), fileName, ConfSizeOf(fileName, isAnnular), [fileName, isAnnular](const EvaluateOptions& options) {
+            if (isAnnular) {
+                return EvaluateConf<AnnularCubicConf>(fileName, options);
+            }
+            return EvaluateConf<CubicConf>(fileName, options);
+        }});
+    }
+    return items;
+}
+
+// sources (.conf ファイル、"-" なら標準入力) の .conf を読み、双対の CubicConf をそのまま判定する BatchItem の一覧にする
+vector<BatchItem> BatchItemsOfConfs(const vector<string>& sources) {
+    vector<BatchItem> items;
+    ForEachPrimalConf(sources, [&](const string& name, const PrimalConf& primal) {
+        auto edges = std::make_shared<const vector<int32_t>>(DualVertexEdges(primal));
+        int vertexSize = edges->size() / 3;
+        int ringSize = primal.R;
+        items.push_back({name, name, {ringSize, vertexSize}, [edges, vertexSize, ringSize](const EvaluateOptions& options) {
+            return EvaluateConfFrom<CubicConf>([&] { return CubicConf::fromVertexEdges(vertexSize, ringSize, edges->data()); }, options);
+        }});
+    });
+    return items;
+}
+
+// 名前 (ログ・queue の結果・checkpoint・証明書のファイル名) が重複している BatchItem の組を、ラベルの組として返す
+vector<pair<string, string>> DuplicateNames(const vector<BatchItem>& items) {
+    std::map<string, const BatchItem*> byName;
+    vector<pair<string, string>> duplicates;
+    for (auto& item : items) {
+        auto [it, inserted] = byName.emplace(item.name, &item);
+        if (!inserted) duplicates.push_back({it->second->label, item.label});
+    }
+    return duplicates;
+}
+
+// items の configuration の判定に必要な Coloring, Kempe chain の表を共有メモリ name に置き、TableProvider から使う
+// 既に他のプロセスが作っていればそれを使う (足りない表は、通常どおりファイルから読み込むか生成する)
+void AttachSharedTables(const string& name, const vector<BatchItem>& items, const EvaluateOptions& options) {
+    auto segment = TableSegment::CreateOrAttach(name, [&] {
+        std::set<int> ringSizes;
+        for (auto& item : items) {
+            if (item.size.first > 0) ringSizes.insert(item.size.first);
+        }
+        int maxRingSize = ringSizes.empty() ? 0 : *ringSizes.rbegin();
+        auto& provider = TableProvider::Instance();
+        auto rowsOf = [](const KempeTable& table) {
+            vector<string> rows;
+            for (size_t i = 0; i < table.size(); i++) rows.push_back(string(table[i]));
+            return rows;
+        };
+        vector<SegmentTable> tables;
+        for (int ringSize : ringSizes) {
+            auto& ringColorings = provider.RingColorings(ringSize);
+            vector<string> rows, order;
+            for (size_t i = 0; i < ringColorings.size(); i++) {
+                rows.push_back(string(ringColorings[i]));
+                int32_t index = ringColorings.OrderAt(i);
+                order.push_back(string(reinterpret_cast<const char*>(&index), sizeof(index)));
+            }
+            tables.push_back({segmentColoringKind, ringSize, 0, std::move(rows)});
+            tables.push_back({segmentColoringOrderKind, ringSize, 0, std::move(order)});
+        }
+        vector<KempeType> types;
+        if (options.isAnnular) types = {Planar};
+        else if (options.allTypes) types = {Planar, Projective, Apex, Toroidal};
+        else types = {options.type};
+        for (auto type : types) {
+            for (int s = 1; s <= maxRingSize / 2; s++) {
+                tables.push_back({uint32_t(type), s, 0, rowsOf(provider.Kempes(s, type))});
+            }
+        }
+        if (options.isAnnular) {
+            for (int l = 1; l < maxRingSize; l++) {
+                for (int r = 1; l + r <= maxRingSize; r++) {
+                    if ((l + r) % 2 == 1) continue;
+                    tables.push_back({annularKempeStoreType, l, r, rowsOf(provider.AnnularKempes(l, r))});
+                }
+            }
+        }
+        return tables;
+    });
+    TableProvider::Instance().AttachSegment(segment);
+}
+
+// 複数の configuration を 1 つのプロセスで判定する
+// Coloring, Kempe chain の表は TableProvider を通して一度だけ読み込まれ、全ての configuration で共有される
+// 時間のかかる大きい configuration から順に options.threadNum 個のスレッドで並列に判定し、それぞれのログは logDir/<名前>.log に出力する
+// queue が与えられた場合は、他のプロセスが完了・判定中のものを飛ばし、ログ (判定の結果) は queue のディレクトリに出力する
+// 失敗した configuration と予算を使い切った configuration の個数を返す (後者は queue では完了とせず、より大きい予算のプロセスに残す)
+struct BatchSummary {
+    int failed = 0;
+    int overBudget = 0;
+};
+BatchSummary EvaluateBatch(vector<BatchItem> items, const EvaluateOptions& options, const string& logDir, JobQueue* queue = nullptr) {
+    std::stable_sort(items.begin(), items.end(), [](const BatchItem& a, const BatchItem& b) {
+        return a.size > b.size;
+    });
+    if (!queue) std::filesystem::create_directories(logDir);
+    RoutingSink::Install();
+    int confNum = items.size();
+    int batchThreadNum = std::max(1, std::min(options.threadNum, confNum));
+    EvaluateOptions confOptions = options;
+    confOptions.threadNum = std::max(1, options.threadNum / batchThreadNum);
+    spdlog::info("Evaluating {} configurations with {} threads", confNum, batchThreadNum);
+    std::atomic<int> finishedCount = 0;
+    std::atomic<int> failedCount = 0;
+    std::atomic<int> overBudgetCount = 0;
+    RunInParallel(confNum, batchThreadNum, [&](int i) {
+        auto& item = items[i];
+        auto& name = item.name;
+        if (queue && queue->IsOverBudget(name, options.timeBudget, options.memoryBudgetMb)) {
+            spdlog::info("[{}/{}] {} skipped (over the same budget before, see {})", ++finishedCount, confNum, item.label, queue->OverBudgetResultPath(name).string());
+            overBudgetCount++;
+            return;
+        }
+        if (queue && !queue->TryAcquire(name)) {
+            spdlog::info("[{}/{}] {} skipped ({})", ++finishedCount, confNum, item.label, queue->IsDone(name) ? "done" : "leased by another process");
+            return;
+        }
+        auto logFile = queue ? queue->TemporaryResultPath(name).string() : (std::filesystem::path(logDir) / name).string() + ".log";
+        auto start = std::chrono::steady_clock::now();
+        bool failed = false;
+        bool overBudget = false;
+        {
+            RoutingSink::Scope scope(logFile);
+            try {
+                auto itemOptions = confOptions;
+                itemOptions.confName = name;
+                auto results = item.evaluate(itemOptions);
+                overBudget = IsOverBudget(results);
+            }
+            catch (const std::exception& e) {
+                spdlog::critical("The program threw an error: {}", e.what());
+                failed = true;
+            }
+        }
+        if (queue && failed) {
+            queue->ReleaseFailed(name, logFile);
+            logFile = queue->FailedResultPath(name).string();
+        }
+        else if (queue && overBudget) {
+            queue->ReleaseOverBudget(name, logFile, options.timeBudget, options.memoryBudgetMb);
+            logFile = queue->OverBudgetResultPath(name).string();
+        }
+        else if (queue) {
+            queue->Complete(name, logFile);
+            logFile = queue->ResultPath(name).string();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        int finished = ++finishedCount;
+        if (failed) {
+            spdlog::error("[{}/{}] {} failed (see {})", finished, confNum, item.label, logFile);
+            failedCount++;
+        }
+        else if (overBudget) {
+            spdlog::warn("[{}/{}] {} exceeded the budget after {:.3f}s (see {})", finished, confNum, item.label, seconds, logFile);
+            overBudgetCount++;
+        }
+        else {
+            spdlog::info("[{}/{}] {} finished in {:.3f}s (see {})", finished, confNum, item.label, seconds, logFile);
+        }
+    });
+    if (failedCount > 0) {
+        spdlog::error("{} of {} configurations failed", failedCount.load(), confNum);
+    }
+    return {failedCount, overBudgetCount};
+}
@@ -0,0 +1,303 @@
+#include "generate_kempes.hpp"
+#include "generate_colors.hpp"
+#include "check_reducibility.hpp"
+
+#include <boost/program_options.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <spdlog/spdlog.h>
+#include <fmt/core.h>
+#include <fmt/ostream.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <functional>
+#include <map>
+
+using namespace boost::program_options;
+
+// 計測に使う configuration (projective_configurations がなくても動くように、小さいものを埋め込んでおく)
+const std::map<string, string> fixtureConfs = {
+    {"birkhoff6",
+        "12 6\n0 6 7\n5 8 9\n7 10 9\n1 11 6\n2 12 13\n11 14 13\n3 15 16\n12 17 16\n4 18 15\n8 19 18\n14 20 10\n20 19 17\n"},
+    {"ring8",
+        "10 8\n0 8 9\n7 10 9\n1 11 12\n8 13 12\n2 14 11\n3 15 14\n4 16 15\n5 17 18\n18 13 16\n6 10 17\n"},
+    {"ring9",
+        "13 9\n0 9 10\n8 11 10\n1 12 9\n2 13 14\n12 15 14\n3 16 13\n4 17 16\n5 18 19\n17 20 19\n6 21 18\n7 22 21\n11 23 22\n15 20 23\n"},
+};
+
+struct BenchResult {
+    string name;
+    long long iterations = 0;
+    double medianNs = 0;
+    double minNs = 0;
+};
+
+// 1 つの計測を、合計の計測時間が minSeconds 以上かつ 3 回以上になるまで繰り返し、1 回あたりの時間の中央値と最小値を記録する
+// setup は毎回 body の前に呼ばれ、その時間は計測に含めない
+class BenchRunner {
+    string filter;
+    double minSeconds;
+    vector<BenchResult> results;
+public:
+    BenchRunner(string filter, double minSeconds) : filter(std::move(filter)), minSeconds(minSeconds) {}
+    bool Selected(const string& name) const {
+        return name.find(filter) != string::npos;
+    }
+    void Run(const string& name, const std::function<void()>& setup, const std::function<void()>& body) {
+        if (!Selected(name)) return;
+        vector<double> samples;
+        double total = 0;
+        while (samples.size() < 3 || (total < minSeconds && samples.size() < 1000000)) {
+            if (setup) setup();
+            auto start = std::chrono::steady_clock::now();
+            body();
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            samples.push_back(ns);
+            total += ns * 1e-9;
+        }
+        std::sort(samples.begin(), samples.end());
+        BenchResult result = {name, (long long)samples.size(), samples[samples.size() / 2], samples[0]};
+        spdlog::warn("{:<48} {:>14.0f} ns (min {:.0f} ns, {} runs)", name, result.medianNs, result.minNs, result.iterations);
+        results.push_back(result);
+    }
+    void Run(const string& name, const std::function<void()>& body) {
+        Run(name, nullptr, body);
+    }
+    const vector<BenchResult>& Results() const {
+        return results;
+    }
+};
+
+// 最適化で計算が消されないように結果を書き込む先
+volatile size_t benchSink = 0;
+
+void WriteResults(const vector<BenchResult>& results, std::ostream& os) {
+    os << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        auto& r = results[i];
+        fmt::print(os, "    {{\"name\": \"{}\", \"iterations\": {}, \"median_ns\": {:.1f}, \"min_ns\": {:.1f}}}{}\n",
+            r.name, r.iterations, r.medianNs, r.minNs, i + 1 < results.size() ? "," : "");
+    }
+    os << "  ]\n}\n";
+}
+
+// baseline (以前の出力) と比べ、中央値が threshold 以上の割合で遅くなったものの個数を返す
+int CompareWithBaseline(const vector<BenchResult>& results, const string& baselineFile, double threshold) {
+    boost::property_tree::ptree tree;
+    try {
+        boost::property_tree::read_json(baselineFile, tree);
+    }
+    catch (const std::exception& e) {
+        spdlog::critical("Error: Failed to read baseline {}: {}", baselineFile, e.what());
+        throw;
+    }
+    std::map<string, double> baseline;
+    for (auto& [key, bench] : tree.get_child("benchmarks")) {
+        baseline[bench.get<string>("name")] = bench.get<double>("median_ns");
+    }
+    int regressions = 0;
+    for (auto& r : results) {
+        auto it = baseline.find(r.name);
+        if (it == baseline.end()) {
+            spdlog::warn("{:<48} (not in baseline)", r.name);
+            continue;
+        }
+        double ratio = r.medianNs / it->second;
+        bool regressed = ratio > 1 + threshold;
+        regressions += regressed;
+        spdlog::warn("{:<48} {:>7.3f}x {}", r.name, ratio, regressed ? "REGRESSION" : "");
+    }
+    return regressions;
+}
+
+void RunMicroBenchmarks(BenchRunner& runner, const std::map<string, CubicConf>& confs) {
+    // Coloring と Kempe chain の表 (Kempe chain の生成)
+    for (auto [type, size] : {std::pair{Planar, 6}, {Projective, 5}, {Apex, 5}, {Toroidal, 5}}) {
+        runner.Run(fmt::format("micro/GenerateKempes/{}/{}", KempeTypeName(type), size), [type, size] {
+            auto kempes = (type == Planar) ? GetPlanarKempes(size) : (type == Projective) ? GetProjectiveKempes(size) : (type == Apex) ? GetApexKempes(size) : GetToroidalKempes(size);
+            benchSink = benchSink + kempes.size();
+        });
+    }
+    runner.Run("micro/GetValidColorings/12", [] {
+        benchSink = benchSink + Coloring::GetValidColorings(12).size();
+    });
+
+    // 表の読み込み (作業ディレクトリに書き出したものを読む)
+    WriteColorFile(12, Coloring::GetValidColorings(12));
+    std::filesystem::create_directories("kempes/proj");
+    WriteKempeFile(KempeFileName(5, Projective), GetProjectiveKempes(5));
+    WriteKempeStore("kempes/bench.bin", Projective, {{5, 0, GetProjectiveKempes(5)}});
+    runner.Run("micro/Load/ColorFile/12", [] {
+        benchSink = benchSink + LoadColorFile(12).size();
+    });
+    runner.Run("micro/Load/KempeTextFile/Projective/5", [] {
+        benchSink = benchSink + LoadKempeTextFile(KempeFileName(5, Projective)).size();
+    });
+    runner.Run("micro/Load/KempeStore/Projective/5", [] {
+        // FindInKempeStore は mmap したファイルを使い回すので、毎回 mmap して索引を読むところから測る
+        auto file = std::make_shared<MappedFile>("kempes/bench.bin");
+        benchSink = benchSink + FindInMappedKempeStore(file, "kempes/bench.bin", Projective, 5, 0)->size();
+    });
+    for (auto& [name, text] : fixtureConfs) {
+        runner.Run("micro/Load/ConfParse/" + name, [&text] {
+            std::istringstream iss(text);
+            benchSink = benchSink + CubicConf::fromFile(iss).edge_size;
+        });
+    }
+
+    // Kempe change
+    {
+        auto& colorings = RingColorings(12);
+        runner.Run("micro/GetKempeChanges/12", [&] {
+            size_t count = 0;
+            for (size_t i = 0; i < colorings.size(); i += 64) {
+                for (int fix = 1; fix <= 3; fix++) {
+                    auto coloring = colorings.At(i);
+                    int withoutSize = coloring.sizeWithout(fix);
+                    if (withoutSize == 0) continue;
+                    auto& kempes = KempesOfRing(withoutSize, Projective);
+                    for (size_t k = 0; k < kempes.size(); k += 8) {
+                        count += coloring.GetKempeChanges(kempes[k], fix).size();
+                    }
+                }
+            }
+            benchSink = benchSink + count;
+        });
+    }
+
+    for (auto& [name, conf] : confs) {
+        auto& colorings = RingColorings(conf.ring_size);
+        runner.Run("micro/CheckColorability/" + name, [&] {
+            benchSink = benchSink + conf.CheckColorability(colorings, {}, false).size();
+        });
+        auto contractions = conf.GetGoodContractions(1, 4);
+        runner.Run("micro/GetGoodContractions/" + name + "/1-4", [&] {
+            benchSink = benchSink + conf.GetGoodContractions(1, 4).size();
+        });
+        if (!contractions.empty()) {
+            vector<int> contractEdges;
+            for (int e = 0; e < conf.edge_size; e++) {
+                if (!contractions.back()[e]) contractEdges.push_back(e);
+            }
+            runner.Run("micro/CheckColorability/" + name + "/contracted", [&] {
+                benchSink = benchSink + conf.CheckColorability(colorings, contractEdges).size();
+            });
+        }
+
+        // D-reducibility check の最初の 1 回分の update
+        auto initialFeasible = conf.CheckColorability(colorings, {}, false);
+        vector<int> indexes(colorings.size());
+        for (int i = 0; i < (int)colorings.size(); i++) indexes[i] = i;
+        vector<bool> feasible;
+        vector<vector<int>> kempeIndexes;
+        for (auto type : {Planar, Projective, Apex, Toroidal}) {
+            RingKempeCache kempeTables(type);
+            runner.Run(fmt::format("micro/OneReduction/{}/{}", name, KempeTypeName(type)), [&] {
+                feasible = initialFeasible;
+                kempeIndexes.assign(colorings.size(), vector<int>(3));
+            }, [&] {
+                benchSink = benchSink + OneReduction<CubicConf>(indexes, colorings, feasible, conf.ring_size, kempeTables, kempeIndexes);
+            });
+        }
+    }
+}
+
+// 判定全体 (EvaluateConf) の計測
+void RunMacroBenchmarks(BenchRunner& runner, const vector<std::pair<string, string>>& confFiles) {
+    for (auto& [name, fileName] : confFiles) {
+        for (auto type : {Planar, Projective}) {
+            EvaluateOptions options;
+            options.type = type;
+            runner.Run(fmt::format("macro/EvaluateConf/{}/{}", name, KempeTypeName(type)), [&] {
+                benchSink = benchSink + EvaluateConf<CubicConf>(fileName, options).size();
+            });
+        }
+    }
+}
+
+int main(const int ac, const char* const* const av) {
+    options_description description("Options");
+    description.add_options()
+        ("filter", value<string>()->default_value(""), "Only run the benchmarks whose name contains this string")
+        ("min-time", value<double>()->default_value(0.5), "Minimum total seconds to repeat each benchmark for")
+        ("output,o", value<string>()->default_value(""), "Write the results as JSON to this file (default: standard output)")
+        ("baseline", value<string>()->default_value(""), "Compare the results with this earlier JSON output, and exit with 1 if some benchmark is slower than the threshold")
+        ("threshold", value<double>()->default_value(0.1), "Relative slowdown of the median counted as a regression")
+        ("confs", value<string>()->default_value("projective_configurations/reducible/dconf"), "Directory of dconf files to pick the macro benchmark configurations from (the first file of each ring size 10, 12 and 14)")
+        ("work-dir", value<string>()->default_value("bench_data"), "Directory to generate the Coloring and Kempe chain tables in")
+        ("help,H", "Display options");
+    variables_map vm;
+    store(parse_command_line(ac, av, description), vm);
+    notify(vm);
+    if (vm.count("help")) {
+        description.print(std::cout);
+        return 0;
+    }
+    // 計測中のログは出さない (結果は warn で出力する)
+    spdlog::set_level(spdlog::level::warn);
+
+    vector<std::pair<string, string>> macroConfs;
+    auto confDir = vm["confs"].as<string>();
+    if (std::filesystem::is_directory(confDir)) {
+        std::map<int, string> firstOfRing;
+        vector<string> files;
+        for (auto& entry : std::filesystem::directory_iterator(confDir)) {
+            if (entry.path().extension() == ".dconf") files.push_back(std::filesystem::absolute(entry.path()).string());
+        }
+        std::sort(files.begin(), files.end());
+        for (auto& fileName : files) {
+            std::ifstream ifs(fileName);
+            int vertexSize = 0, ringSize = 0;
+            ifs >> vertexSize >> ringSize;
+            if ((ringSize == 10 || ringSize == 12 || ringSize == 14) && !firstOfRing.count(ringSize)) firstOfRing[ringSize] = fileName;
+        }
+        for (auto& [ringSize, fileName] : firstOfRing) {
+            macroConfs.push_back({std::filesystem::path(fileName).stem().string(), fileName});
+        }
+    }
+    else {
+        spdlog::warn("{} not found, running the macro benchmarks on the built-in configurations only", confDir);
+    }
+
+    auto workDir = vm["work-dir"].as<string>();
+    auto originalDir = std::filesystem::current_path();
+    std::filesystem::create_directories(workDir / std::filesystem::path("fixtures"));
+    std::filesystem::current_path(workDir);
+    std::map<string, CubicConf> confs;
+    vector<std::pair<string, string>> fixtureFiles;
+    for (auto& [name, text] : fixtureConfs) {
+        std::istringstream iss(text);
+        confs.emplace(name, CubicConf::fromFile(iss));
+        auto fileName = "fixtures/" + name + ".dconf";
+        std::ofstream(fileName) << text;
+        fixtureFiles.push_back({name, fileName});
+    }
+    macroConfs.insert(macroConfs.begin(), fixtureFiles.begin(), fixtureFiles.end());
+
+    BenchRunner runner(vm["filter"].as<string>(), vm["min-time"].as<double>());
+    RunMicroBenchmarks(runner, confs);
+    RunMacroBenchmarks(runner, macroConfs);
+
+    auto outputFile = vm["output"].as<string>();
+    std::filesystem::current_path(originalDir);
+    if (outputFile.empty()) {
+        WriteResults(runner.Results(), std::cout);
+    }
+    else {
+        std::ofstream ofs(outputFile);
+        WriteResults(runner.Results(), ofs);
+    }
+    auto baselineFile = vm["baseline"].as<string>();
+    if (!baselineFile.empty()) {
+        try {
+            return CompareWithBaseline(runner.Results(), baselineFile, vm["threshold"].as<double>()) > 0 ? 1 : 0;
+        }
+        catch (const std::exception&) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+#include <unistd.h>
+#include <fmt/core.h>
+
+using std::string;
+
+// 予算 (時間・メモリ) を使い切ったときに投げる例外
+class BudgetExceeded : public std::runtime_error {
+public:
+    explicit BudgetExceeded(const string& what) : std::runtime_error(what) {}
+};
+
+// 1 つの configuration の判定に使える時間 (秒) とメモリ (判定を始めてから増えたプロセス全体の常駐メモリ、MiB) の上限
+// メモリは判定を始めたときの常駐メモリからの増加で測るので、同じプロセスで先に判定したものが残した表のキャッシュや解放済みのヒープは数えない
+// 判定する側は重いループの中で Budget::Poll() を呼び、上限を超えていれば BudgetExceeded が投げられる (協調的な中断)
+// Poll は呼び出し回数を数えるだけで、時刻は pollInterval 回に 1 回、メモリは memoryCheckSeconds 秒に 1 回だけ調べる
+// 有効な Budget はスレッドごとに Scope で設定する (設定されていないスレッドでは Poll は何もしない)
+class Budget {
+    static constexpr int pollInterval = 1 << 12;
+    static constexpr double memoryCheckSeconds = 0.1;
+    static inline thread_local Budget* current = nullptr;
+    static inline thread_local int countdown = pollInterval;
+    static inline thread_local std::chrono::steady_clock::time_point nextMemoryCheck;
+
+    double timeLimit; // 0 なら無制限
+    int64_t memoryLimitMb; // 0 なら無制限
+    int64_t startResidentMb = 0; // 判定を始めたときの常駐メモリ
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    // 中断したときに報告する途中経過 (判定しているスレッドだけが書く)
+    int iteration = -1; // D-reducibility check の update の回数 (-1 なら始まっていない)
+    int feasibleCount = 0;
+    int colorNum = 0;
+    int contCount = -1; // 試し終えた contraction の個数 (-1 なら始まっていない)
+    int contTotal = 0;
+    int contSize = 0; // 試している contraction の大きさ (これより小さいものはすべて試し終えている)
+
+    // 常駐メモリ (MiB)
+    static int64_t ResidentMb() {
+        std::ifstream ifs("/proc/self/statm");
+        int64_t size = 0, resident = 0;
+        ifs >> size >> resident;
+        return resident * ::sysconf(_SC_PAGESIZE) / (1 << 20);
+    }
+    void CheckNow() {
+        countdown = pollInterval;
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - start).count();
+        if (timeLimit > 0 && elapsed > timeLimit) {
+            throw BudgetExceeded(fmt::format("time budget of {}s exceeded", timeLimit));
+        }
+        if (memoryLimitMb > 0 && now >= nextMemoryCheck) {
+            nextMemoryCheck = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(memoryCheckSeconds));
+            auto resident = ResidentMb();
+            if (resident - startResidentMb > memoryLimitMb) {
+                throw BudgetExceeded(fmt::format("memory budget of {} MiB exceeded ({} MiB resident, {} MiB at the start)", memoryLimitMb, resident, startResidentMb));
+            }
+        }
+    }
+public:
+    Budget(double timeLimit, int64_t memoryLimitMb) : timeLimit(timeLimit), memoryLimitMb(memoryLimitMb) {
+        if (memoryLimitMb > 0) startResidentMb = ResidentMb();
+    }
+    Budget(const Budget&) = delete;
+    Budget& operator=(const Budget&) = delete;
+    // このスレッドで使う Budget を設定する (スコープを抜けると元に戻る)
+    class Scope {
+        Budget* previous;
+    public:
+        explicit Scope(Budget* budget) : previous(current) {
+            current = budget;
+            countdown = pollInterval;
+            nextMemoryCheck = std::chrono::steady_clock::now();
+        }
+        ~Scope() {
+            current = previous;
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+    static Budget* Current() {
+        return current;
+    }
+    static void Poll() {
+        if (current && --countdown <= 0) current->CheckNow();
+    }
+    static void RecordFeasible(int iteration, int feasibleCount, int colorNum) {
+        if (!current) return;
+        current->iteration = iteration;
+        current->feasibleCount = feasibleCount;
+        current->colorNum = colorNum;
+    }
+    static void RecordContractions(int contCount, int contTotal, int contSize) {
+        if (!current) return;
+        current->contCount = contCount;
+        current->contTotal = contTotal;
+        current->contSize = contSize;
+    }
+    // 中断した時点までの途中経過
+    string ProgressSummary() const {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        string res = fmt::format("stopped after {:.3f}s", elapsed);
+        if (iteration < 0) {
+            res += ", before the D-reducibility check";
+        }
+        else {
+            res += fmt::format(", D-reducibility iterations done: {}, feasible / total: {} / {}", iteration, feasibleCount, colorNum);
+        }
+        if (contCount >= 0) {
+            res += fmt::format(", contractions tried: {} / {}", contCount, contTotal);
+            if (contSize > 0) res += fmt::format(" (all of size < {} tried)", contSize);
+        }
+        return res;
+    }
+};
@@ -0,0 +1,113 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <optional>
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+#include <cstdint>
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+#include <fmt/core.h>
+#include <fmt/ranges.h>
+#include "generate_kempes.hpp"
+
+using std::string;
+using std::vector;
+using std::optional;
+
+// 判定に成功した configuration の証明書 (<dir>/<名前>.cert)
+// 再検証では D-reducibility check と、記録された 1 つの contraction の判定だけを行えばよい
+// 1 行目は "reducibility-certificate 1"、2 行目は "conf <CubicConf::Hash> <HashColorings>"、以降は Kempe type ごとに 1 行:
+//   <Kempe type> D <feasible のハッシュ値>
+//   <Kempe type> C <feasible のハッシュ値> <縮約する辺 (カンマ区切り)>
+// feasible のハッシュ値は D-reducibility check の不動点での HashFeasibles で、不動点に達する前に C-reducible と分かった場合は -
+struct Certificate {
+    struct Entry {
+        KempeType type;
+        char kind; // 'D': D-reducible, 'C': C-reducible
+        optional<uint64_t> feasibleHash;
+        vector<int> contraction; // 'C' の場合、縮約する辺
+    };
+    uint64_t confHash = 0;
+    uint64_t coloringHash = 0;
+    vector<Entry> entries;
+};
+constexpr int certificateVersion = 1;
+
+string CertificateFileName(const string& dir, const string& name) {
+    return (std::filesystem::path(dir) / (name + ".cert")).string();
+}
+
+optional<KempeType> KempeTypeOf(const string& name) {
+    for (auto type : {Planar, Projective, Apex, Toroidal}) {
+        if (name == KempeTypeName(type)) return type;
+    }
+    return std::nullopt;
+}
+
+// 一時ファイルに書いてから rename する
+void WriteCertificate(const string& fileName, const Certificate& certificate) {
+    std::filesystem::create_directories(std::filesystem::path(fileName).parent_path());
+    auto temporary = fileName + ".tmp";
+    {
+        std::ofstream ofs(temporary);
+        if (!ofs) {
+            spdlog::critical("Error: Failed to open {}", temporary);
+            throw std::runtime_error("Error opening " + temporary);
+        }
+        ofs << fmt::format("reducibility-certificate {}\n", certificateVersion);
+        ofs << fmt::format("conf {:016x} {:016x}\n", certificate.confHash, certificate.coloringHash);
+        for (auto& entry : certificate.entries) {
+            auto hash = entry.feasibleHash ? fmt::format("{:016x}", *entry.feasibleHash) : string("-");
+            if (entry.kind == 'D') {
+                ofs << fmt::format("{} D {}\n", KempeTypeName(entry.type), hash);
+            }
+            else {
+                ofs << fmt::format("{} C {} {}\n", KempeTypeName(entry.type), hash, fmt::join(entry.contraction, ","));
+            }
+        }
+    }
+    std::filesystem::rename(temporary, fileName);
+    spdlog::info("Wrote the certificate to {}", fileName);
+}
+
+Certificate LoadCertificate(const string& fileName) {
+    std::ifstream ifs(fileName);
+    if (!ifs) {
+        spdlog::critical("Error: Failed to open {}", fileName);
+        throw std::runtime_error("Error opening " + fileName);
+    }
+    auto invalid = [&](const string& what) {
+        spdlog::critical("Error: {} is not a valid certificate ({})", fileName, what);
+        throw std::runtime_error("Invalid certificate " + fileName);
+    };
+    Certificate certificate;
+    string magic, conf, confHash, coloringHash;
+    int version = 0;
+    if (!(ifs >> magic >> version) || magic != "reducibility-certificate") invalid("header");
+    if (version != certificateVersion) invalid(fmt::format("version {}", version));
+    if (!(ifs >> conf >> confHash >> coloringHash) || conf != "conf") invalid("conf line");
+    certificate.confHash = std::stoull(confHash, nullptr, 16);
+    certificate.coloringHash = std::stoull(coloringHash, nullptr, 16);
+    string line;
+    std::getline(ifs, line);
+    while (std::getline(ifs, line)) {
+        std::istringstream iss(line);
+        string typeName, kind, hash, edges;
+        if (!(iss >> typeName)) continue;
+        auto type = KempeTypeOf(typeName);
+        if (!type || !(iss >> kind >> hash) || (kind != "D" && kind != "C")) invalid(fmt::format("line \"{}\"", line));
+        Certificate::Entry entry = {*type, kind[0], std::nullopt, {}};
+        if (hash != "-") entry.feasibleHash = std::stoull(hash, nullptr, 16);
+        if (entry.kind == 'C') {
+            if (!(iss >> edges)) invalid(fmt::format("no contraction in \"{}\"", line));
+            std::istringstream edgeStream(edges);
+            string e;
+            while (std::getline(edgeStream, e, ',')) entry.contraction.push_back(std::stoi(e));
+        }
+        certificate.entries.push_back(entry);
+    }
+    if (certificate.entries.empty()) invalid("no results");
+    return certificate;
+}
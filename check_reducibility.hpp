@@ -3,28 +3,95 @@
 #include <algorithm>
 #include <map>
 #include <optional>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <future>
+#include <exception>
 #include <spdlog/spdlog.h>
-#include "generate_kempes.hpp"
-#include "generate_colors.hpp"
+#include "table_provider.hpp"
 #include "cubic_conf.hpp"
 #include "feasibles.hpp"
+#include "colorability_cache.hpp"
+#include "verdict_cache.hpp"
+#include "progress.hpp"
+#include "certificate.hpp"
+#include "checkpoint.hpp"
+#include "budget.hpp"
 
 using std::string;
+using std::optional;
 
-// 一回分の feasibility update を行い、infeasible -> feasible にできた Coloring の個数を返す
+// C-reducible に成功したあと、プログラムをどのように停止させるか
+enum HaltType {
+    HaltImmediately, // すぐに停止
+    HaltAfterSameSize, // 同じ大きさの contraction をすべて試したのち停止
+    NoHalt, // 停止しない
+};
+
+// EvaluateConf に渡すオプション
+struct EvaluateOptions {
+    KempeType type = Projective;
+    HaltType haltType = HaltImmediately;
+    int minCont = 1; // 縮約する辺の個数の最小値
+    int maxCont = 0; // 縮約する辺の個数の最大値 (0 以下なら制限なし)
+    string feasibleFile;
+    bool readFromFeasible = false;
+    bool writeToFeasible = false;
+    bool rotateColoringOfFeasible = false;
+    bool warmStartFromFeasible = false; // バイナリの feasible file に保存した途中状態から D-reducibility check を続ける
+    bool outputWithoutDReducibleCheck = false;
+    bool hasEdgeSet = false;
+    vector<int> edgeSet;
+    bool isAnnular = false;
+    bool prioritize = false; // 同じ大きさの contraction の中で、成功しそうなものから試す
+    int goalContMax = 0; // goal-directed な D-reducibility check で対象とする contraction の大きさの最大値 (0 なら使わない)
+    bool pipelined = false; // D-reducibility check と contraction ごとの計算を並行して行う
+    int threadNum = 1; // 並行して計算するときのスレッド数
+    string cacheDir; // contraction ごとの CheckColorability の結果を保存するディレクトリ (空なら保存しない)
+    bool allTypes = false; // 4 種類の Kempe type すべてについて判定する
+    bool useSymmetry = false; // リングの対称性を使って D-reducibility check で update する Coloring を減らす
+    string verdictCacheDir; // 判定結果を configuration の標準形ごとに保存するディレクトリ (空なら保存しない)
+    string certificateDir; // 判定に成功した configuration の証明書を出力するディレクトリ (空なら出力しない)
+    bool verifyCertificates = false; // 判定する代わりに certificateDir にある証明書を再検証する
+    string confName; // 証明書・checkpoint のファイル名に使う configuration の名前
+    string checkpointDir; // 判定の途中状態を定期的に保存するディレクトリ (空なら保存しない)
+    double checkpointInterval = 600; // checkpoint を書き出す間隔 (秒)
+    bool resume = false; // checkpointDir に checkpoint があれば、そこから判定を再開する
+    double timeBudget = 0; // 1 つの configuration の判定に使える時間 (秒、0 なら無制限)
+    int64_t memoryBudgetMb = 0; // 判定中のプロセスの常駐メモリの上限 (MiB、0 なら無制限)
+};
+
+// 1 つの Kempe type についての判定結果
+struct ReducibilityResult {
+    KempeType type;
+    bool isDReducible = false;
+    bool isCReducible = false;
+    vector<int> contraction; // C-reducible の場合、成功した contraction で縮約した辺
+    optional<uint64_t> feasibleHash; // D-reducibility check の不動点での feasible の HashFeasibles (不動点に達する前に停止した場合などは std::nullopt)
+    bool budgetExceeded = false; // 時間・メモリの予算を使い切って判定を中断した (reducibility は決まっていない)
+};
+
+// indexes に含まれる Coloring について一回分の feasibility update を行い、infeasible -> feasible にできた Coloring の個数を返す
+// orbitRep が与えられた場合、Kempe change で得られた Coloring の feasibility はその orbit の代表元のものを見る
 template <Configuration Conf>
-int OneReduction(int colorNum, const vector<Coloring>& normalColorings, vector<bool>& feasible,
+int OneReduction(const vector<int>& indexes, const ColoringTable& normalColorings, vector<bool>& feasible,
     typename RingShape<Conf>::Type originalRingShape, 
-    const std::map<typename RingShape<Conf>::Type, vector<string>>& allKempes, vector<vector<int>>& kempeIndexes, 
-    const unordered_map<Coloring, int>& coloringRev) {
+    RingKempeCache& kempeTables, vector<vector<int>>& kempeIndexes, 
+    const vector<int>* orbitRep = nullptr) {
     using RingType = typename RingShape<Conf>::Type;
     auto& newFeasible = feasible;
     const auto isFeasible = feasible;
     int updateCount = 0;
-    for (int i = 0; i < colorNum; i++) {
-        auto& colors = normalColorings[i];
+    uint64_t patternCount = 0, lookupCount = 0;
+    for (int i : indexes) {
+        Progress::Advance();
+        Budget::Poll();
         auto varFeasible = isFeasible[i];
         if (!varFeasible) {
+            auto colors = normalColorings.At(i);
             bool someColorWorks = false;
             spdlog::debug("Checking for Coloring: {}", colors.StringOf());
             for (int fix = 1; fix <= 3; fix++) {
@@ -47,23 +114,27 @@ int OneReduction(int colorNum, const vector<Coloring>& normalColorings, vector<b
                 else {
                     static_assert(!std::same_as<RingType, void>);
                 }
-                auto& kempes = allKempes.at(withoutSize);
+                auto& kempes = kempeTables.Of(withoutSize);
                 bool everyKempeWorks = true;
                 auto& kempeIndex = kempeIndexes[i][fix - 1];
                 spdlog::trace("Checking {} kempe chains from {}", kempes.size(), kempeIndex);
                 for (;kempeIndex < (int)kempes.size(); kempeIndex++) {
-                    auto& kempe = kempes[kempeIndex];
+                    patternCount++;
+                    auto kempe = kempes[kempeIndex];
                     auto kempeChanges = colors.GetKempeChanges(kempe, fix);
                     bool changable = false;
                     spdlog::trace("[{}/{}] {}", kempeIndex, kempes.size(), kempe);
                     int changedIndex = 0;
                     for (auto& changedColor : kempeChanges) {
                         spdlog::trace("[[{}/{}]] {}", changedIndex, kempeChanges.size(), changedColor.StringOf());
-                        if (!coloringRev.count(changedColor)) {
-                            spdlog::trace("{} does not exist in rev", changedColor.StringOf());
-                        }
                         // 同時更新をする (iteration 回数が少なくなる？)
-                        if (feasible[coloringRev.at(changedColor)]) {
+                        lookupCount++;
+                        auto changedIndex = normalColorings.IndexOf(changedColor.StringOf());
+                        if (changedIndex < 0) {
+                            spdlog::critical("Error: {} does not exist in the coloring table", changedColor.StringOf());
+                            throw std::runtime_error("Coloring not found");
+                        }
+                        if (feasible[orbitRep ? (*orbitRep)[changedIndex] : changedIndex]) {
                             changable = true;
                             break;
                         }
@@ -85,150 +156,475 @@ int OneReduction(int colorNum, const vector<Coloring>& normalColorings, vector<b
             updateCount += someColorWorks ? 1 : 0;
         }
     }
-    for (int i = 0; i < colorNum; i++) { 
-        auto& colors = normalColorings[i];
+    Metrics::Add(KempePatternsTested, patternCount);
+    Metrics::Add(ColoringLookups, lookupCount);
+    for (int i : indexes) { 
         if (newFeasible[i]) {
-            spdlog::trace("{}: OK", colors.StringOf());
+            spdlog::trace("{}: OK", normalColorings[i]);
         }
         else {
-            spdlog::trace("{}: NG", colors.StringOf());
+            spdlog::trace("{}: NG", normalColorings[i]);
         }
     }
     return updateCount;
 }
 
-template <Configuration Conf>
-vector<bool> CheckDReducibility(Conf& conf, KempeType type, bool skipDReducibility) {
-    vector<vector<Coloring>> allColorings;
-    for (int s = 1; s <= conf.ring_size; s++) {
-        auto colorings = LoadColorFile(s);
-        allColorings.push_back(colorings);
+// 大きさ ringSize 以下のリング上の Kempe chain の集合が、リングの回転 (checkReflections なら反転も) で閉じていない最小の大きさを返す
+optional<int> FirstKempeSizeNotClosed(int ringSize, KempeType type, bool checkReflections) {
+    for (int size = 2; size <= ringSize; size += 2) {
+        auto& kempes = KempesOfRing(size, type);
+        unordered_set<std::string_view> kempeSet;
+        for (size_t i = 0; i < kempes.size(); i++) kempeSet.insert(kempes[i]);
+        for (auto kempe : kempeSet) {
+            string rotated = string(kempe.substr(1)) + kempe[0];
+            reassign(rotated);
+            string reversed(kempe.rbegin(), kempe.rend());
+            reassign(reversed);
+            if (!kempeSet.count(rotated) || (checkReflections && !kempeSet.count(reversed))) {
+                return size;
+            }
+        }
     }
+    return std::nullopt;
+}
+
+// D-reducibility の判定に必要な Coloring, Kempe chain の情報と、各 Coloring の feasibility を保持する
+template <Configuration Conf>
+class DReducibilityChecker {
     using RingType = typename RingShape<Conf>::Type;
-    std::map<RingType, vector<string>> allKempes;
     RingType originalRingShape;
-    if constexpr (std::same_as<RingType, pair<int, int>>) {
-        originalRingShape = conf.annularRing();
-        for (int l = 0; l <= conf.left_ring_size; l++) {
-            for (int r = 0; r <= conf.right_ring_size; r++) {
-                if ((l + r) % 2 == 1) continue;
-                if (l + r == 0) continue;
-                if (l == 0) {
-                    auto kempes = LoadKempeFile(r / 2, Planar);
-                    allKempes.insert({{l, r}, kempes});
-                }
-                else if (r == 0) {
-                    auto kempes = LoadKempeFile(l / 2, Planar);
-                    allKempes.insert({{l, r}, kempes});
-                }
-                else {
-                    auto kempes = LoadAnnularKempeFile(l, r);
-                    allKempes.insert({{l, r}, kempes});
+    KempeType type;
+    RingKempeCache kempeTables;
+    ColoringTable normalColorings;
+    vector<bool> isFeasible;
+    vector<vector<int>> kempeIndexes; // 各 Coloring, fix について、どの Kempe chain まで成功したか
+    vector<int> allIndexes; // 不動点まで update するときに update する Coloring (対称性を使う場合は orbit の代表元のみ)
+    vector<int> orbitRep; // 対称性を使う場合、各 Coloring の orbit の代表元
+    int feasibleCount = 0;
+    int iterationCount = 0;
+    int sweepPosition = 0; // 途中まで行った update で、処理し終えた Coloring の個数
+    int sweepUpdateCount = 0; // 途中まで行った update で、feasible にできた Coloring の個数
+    std::function<void()> checkpoint; // 設定されている場合、update の途中と update ごとに呼び出す
+public:
+    // リングの大きさ conf.ring_size の Coloring
+    static ColoringTable LoadRingColorings(const Conf& conf) {
+        return RingColorings(conf.ring_size);
+    }
+    DReducibilityChecker(const Conf& conf, KempeType type) : DReducibilityChecker(conf, type, LoadRingColorings(conf)) {}
+    // colorings と、それぞれの Coloring が (Kempe chain を使わずに) 内部に拡張可能か (initialFeasible) が計算済みの場合に使う
+    DReducibilityChecker(const Conf& conf, KempeType type, ColoringTable colorings, optional<vector<bool>> initialFeasible = std::nullopt) : type(type), kempeTables(type) {
+        if constexpr (std::same_as<RingType, pair<int, int>>) {
+            originalRingShape = conf.annularRing();
+        }
+        else if constexpr (std::same_as<RingType, int>) {
+            originalRingShape = conf.ring_size;
+        }
+        else {
+            static_assert(!std::same_as<RingType, void>);
+        }
+        normalColorings = std::move(colorings);
+        if (initialFeasible) {
+            isFeasible = std::move(*initialFeasible);
+        }
+        else {
+            PhaseTimer phase("initial colorability");
+            Progress::Start("initial colorability", 0, "colorings");
+            isFeasible = conf.CheckColorability(normalColorings, {}, false);
+        }
+        feasibleCount = std::count(isFeasible.begin(), isFeasible.end(), true);
+        int colorNum = normalColorings.size();
+        kempeIndexes.assign(colorNum, vector<int>(3));
+        allIndexes.resize(colorNum);
+        for (int i = 0; i < colorNum; i++) allIndexes[i] = i;
+    }
+    const ColoringTable& Colorings() const {
+        return normalColorings;
+    }
+    const vector<bool>& Feasible() const {
+        return isFeasible;
+    }
+    int FeasibleCount() const {
+        return feasibleCount;
+    }
+    int ColorNum() const {
+        return normalColorings.size();
+    }
+    bool IsDReducible() const {
+        return feasibleCount == ColorNum();
+    }
+    // 他の方法で feasible と分かっている Coloring を feasible にする
+    void WarmStart(const vector<bool>& knownFeasible) {
+        for (int i = 0; i < ColorNum(); i++) {
+            if (knownFeasible[i] && !isFeasible[i]) {
+                isFeasible[i] = true;
+                feasibleCount++;
+            }
+        }
+    }
+    const vector<vector<int>>& KempeIndexes() const {
+        return kempeIndexes;
+    }
+    // 以前の D-reducibility check の途中状態 (feasibility と、どの Kempe chain まで成功したか) から続ける
+    // feasible は増える一方なので、一度成功した Kempe chain はその後も成功する
+    void Restore(const vector<bool>& knownFeasible, const vector<vector<int>>& knownKempeIndexes) {
+        WarmStart(knownFeasible);
+        for (int i = 0; i < ColorNum(); i++) {
+            for (int fix = 0; fix < 3; fix++) {
+                kempeIndexes[i][fix] = std::max(kempeIndexes[i][fix], knownKempeIndexes[i][fix]);
+            }
+        }
+    }
+    // checkpoint で中断した update の途中から再開する (feasibility と Kempe chain の位置は Restore で戻しておく)
+    void ResumeSweep(int iteration, int position, int updateCount) {
+        iterationCount = iteration;
+        sweepPosition = position;
+        sweepUpdateCount = updateCount;
+        feasibleCount -= updateCount;
+    }
+    int IterationCount() const {
+        return iterationCount;
+    }
+    int SweepPosition() const {
+        return sweepPosition;
+    }
+    int SweepUpdateCount() const {
+        return sweepUpdateCount;
+    }
+    // 定期的に呼び出す関数を設定する (呼び出された側で、前回からの時間を見て checkpoint を書き出す)
+    // 設定されている場合、update は Coloring をいくつかずつに分けて行う (Coloring i の feasibility を書き換えるのは i の処理だけなので、結果は変わらない)
+    void SetCheckpoint(std::function<void()> checkpoint) {
+        this->checkpoint = std::move(checkpoint);
+    }
+    // configuration のリングの対称性 (リングを回転・反転させるような自己同型) を探し、
+    // 互いに移り合う Coloring (orbit) の代表元だけを update するようにする
+    // 対称性で移り合う Coloring の feasibility は等しいが、それは Kempe chain の集合がリングの回転・反転で閉じている場合に限る
+    void UseSymmetry(const Conf& conf) {
+        if constexpr (std::same_as<RingType, int>) {
+            auto symmetries = conf.GetRingSymmetries();
+            if (symmetries.empty()) {
+                spdlog::debug("No ring symmetries found");
+                return;
+            }
+            bool hasReflection = std::any_of(symmetries.begin(), symmetries.end(), [&](const vector<int>& perm) {
+                return conf.ring_size >= 3 && perm[1] != (perm[0] + 1) % conf.ring_size;
+            });
+            if (auto size = FirstKempeSizeNotClosed(conf.ring_size, type, hasReflection)) {
+                spdlog::info("Kempe chains of size {} are not closed under the ring symmetries, not using symmetries", *size);
+                return;
+            }
+            auto& action = RingAction(conf.ring_size);
+            vector<const int32_t*> rows;
+            for (auto& perm : symmetries) rows.push_back(action.Row(action.ElementOf(perm)));
+            int colorNum = ColorNum();
+            orbitRep.assign(colorNum, -1);
+            allIndexes.clear();
+            for (int i = 0; i < colorNum; i++) {
+                if (orbitRep[i] >= 0) continue;
+                orbitRep[i] = i;
+                allIndexes.push_back(i);
+                vector<int> stack = {i};
+                while (!stack.empty()) {
+                    int j = stack.back();
+                    stack.pop_back();
+                    for (auto row : rows) {
+                        int k = row[j];
+                        if (orbitRep[k] < 0) {
+                            orbitRep[k] = i;
+                            stack.push_back(k);
+                        }
+                    }
                 }
             }
+            spdlog::info("Using {} ring symmetries: {} orbits out of {} colorings", symmetries.size(), allIndexes.size(), colorNum);
         }
     }
-    else if constexpr (std::same_as<RingType, int>) {
-        originalRingShape = conf.ring_size;
-        for (int s = 1; s <= conf.ring_size / 2; s++) {
-            auto kempes = LoadKempeFile(s, type);
-            allKempes.insert({s * 2, kempes});
+    // indexes に含まれる Coloring だけについて一回分の update を行い、feasible にできた個数を返す
+    int Reduce(const vector<int>& indexes) {
+        int updateCount;
+        auto orbitRepOrNull = orbitRep.empty() ? nullptr : &orbitRep;
+        if (!checkpoint) {
+            updateCount = OneReduction<Conf>(indexes, normalColorings, isFeasible, originalRingShape, kempeTables, kempeIndexes, orbitRepOrNull);
+        }
+        else {
+            int chunkSize = std::max<int>(1 << 12, indexes.size() / 1024);
+            while (sweepPosition < (int)indexes.size()) {
+                int end = std::min<int>(indexes.size(), sweepPosition + chunkSize);
+                vector<int> chunk(indexes.begin() + sweepPosition, indexes.begin() + end);
+                sweepUpdateCount += OneReduction<Conf>(chunk, normalColorings, isFeasible, originalRingShape, kempeTables, kempeIndexes, orbitRepOrNull);
+                sweepPosition = end;
+                if (sweepPosition < (int)indexes.size()) checkpoint();
+            }
+            updateCount = sweepUpdateCount;
+            sweepPosition = 0;
+            sweepUpdateCount = 0;
+        }
+        if (orbitRep.empty()) {
+            feasibleCount += updateCount;
+            Progress::SetFeasible(feasibleCount, ColorNum());
+            return updateCount;
         }
+        // orbit 内の feasibility をそろえる
+        int colorNum = ColorNum();
+        for (int i = 0; i < colorNum; i++) {
+            if (isFeasible[i]) isFeasible[orbitRep[i]] = true;
+        }
+        for (int i = 0; i < colorNum; i++) {
+            if (isFeasible[orbitRep[i]]) isFeasible[i] = true;
+        }
+        int newFeasibleCount = std::count(isFeasible.begin(), isFeasible.end(), true);
+        updateCount = newFeasibleCount - feasibleCount;
+        feasibleCount = newFeasibleCount;
+        Progress::SetFeasible(feasibleCount, colorNum);
+        return updateCount;
     }
-    else {
-        static_assert(!std::same_as<RingType, void>);
+    // すべての Coloring について、feasible が更新されなくなるまで update を繰り返す
+    // shouldStop が与えられた場合、update のたびに呼び出し、true を返せばその場で中断して false を返す
+    bool ReduceToFixpoint(const std::function<bool()>& shouldStop = nullptr) {
+        int colorNum = ColorNum();
+        while (feasibleCount != colorNum) {
+            spdlog::info("#{}: Feasible / Total: {} / {}", iterationCount + 1, feasibleCount, colorNum);
+            Budget::RecordFeasible(iterationCount, feasibleCount, colorNum);
+            int updateCount;
+            {
+                PhaseTimer phase(fmt::format("D iteration {}", iterationCount + 1));
+                Progress::Start(fmt::format("D iteration {}", iterationCount + 1), allIndexes.size(), "colorings");
+                Progress::SetFeasible(feasibleCount, colorNum);
+                updateCount = Reduce(allIndexes);
+            }
+            if (updateCount == 0) {
+                break;
+            }
+            iterationCount++;
+            if (checkpoint) checkpoint();
+            if (feasibleCount != colorNum && shouldStop && shouldStop()) {
+                return false;
+            }
+        }
+        spdlog::info("#{}: Feasible / Total: {} / {}", iterationCount + 1, feasibleCount, colorNum);
+        Budget::RecordFeasible(iterationCount, feasibleCount, colorNum);
+        if (feasibleCount == colorNum) {
+            spdlog::info("Graph is D-reducible!");
+        }
+        else {
+            spdlog::info("Graph is not D-reducible.");
+        }
+        return true;
     }
-    auto& normalColorings = allColorings[conf.ring_size - 1];
-    auto isFeasible = conf.CheckColorability(normalColorings, {}, false);
+};
+
+template <Configuration Conf>
+vector<bool> CheckDReducibility(DReducibilityChecker<Conf>& checker, const Conf& conf, bool skipDReducibility, bool useSymmetry = false) {
     if (skipDReducibility) {
         spdlog::info("Skipped D-reducibility check");
-        return isFeasible;
+        return checker.Feasible();
     }
-    int feasibleCount = std::count(isFeasible.begin(), isFeasible.end(), true);
-    int colorNum = normalColorings.size();
-    unordered_map<Coloring, int> coloringRev;
-    for (int i = 0; i < colorNum; i++) {
-        coloringRev[normalColorings[i]] = i;
+    if (useSymmetry) {
+        checker.UseSymmetry(conf);
     }
-    vector<vector<int>> kempeIndexes(colorNum, vector<int>(3));
-    int iterationCount = 0;
     spdlog::info("Started D-reducibility check");
-    while (feasibleCount != colorNum) {
-        spdlog::info("#{}: Feasible / Total: {} / {}", iterationCount + 1, feasibleCount, colorNum);
-        int updateCount = OneReduction<Conf>(colorNum, normalColorings, isFeasible, originalRingShape, allKempes, kempeIndexes, coloringRev);
-        feasibleCount += updateCount;
-        if (updateCount == 0) {
-            break;
-        }
-        iterationCount++;
-    }
-    spdlog::info("#{}: Feasible / Total: {} / {}", iterationCount + 1, feasibleCount, colorNum);
-    if (feasibleCount == colorNum) {
-        spdlog::info("Graph is D-reducible!");
+    checker.ReduceToFixpoint();
+    return checker.Feasible();
+}
+
+template <Configuration Conf>
+vector<bool> CheckDReducibility(Conf& conf, KempeType type, bool skipDReducibility, bool useSymmetry = false) {
+    DReducibilityChecker<Conf> checker(conf, type);
+    return CheckDReducibility(checker, conf, skipDReducibility, useSymmetry);
+}
+
+// conf を type で判定した feasible file のヘッダ
+template <Configuration Conf>
+FeasibleFileHeader FeasibleFileHeaderFor(const Conf& conf, KempeType type) {
+    FeasibleFileHeader header = {};
+    if constexpr (std::same_as<Conf, AnnularCubicConf>) {
+        header.left = conf.annularRing().first;
+        header.right = conf.annularRing().second;
+        header.kempeType = annularKempeStoreType;
     }
     else {
-        spdlog::info("Graph is not D-reducible.");
+        header.left = conf.ring_size;
+        header.kempeType = type;
     }
-    return isFeasible;
+    header.coloringHash = HashColorings(RingColorings(conf.ring_size));
+    header.confHash = conf.Hash();
+    return header;
 }
 
-// C-reducible に成功したあと、プログラムをどのように停止させるか
-enum HaltType {
-    HaltImmediately, // すぐに停止
-    HaltAfterSameSize, // 同じ大きさの contraction をすべて試したのち停止
-    NoHalt, // 停止しない
-};
+// feasible file を読み込む (拡張子が .bin ならバイナリで、conf, type と一致するか確認する)
+template <Configuration Conf>
+vector<bool> LoadFeasiblesFor(const Conf& conf, KempeType type, const string& fileName) {
+    if (!IsBinaryFeasibleFile(fileName)) {
+        auto feasible = LoadFeasibles(fileName);
+        if (feasible.size() != RingColorings(conf.ring_size).size()) {
+            spdlog::critical("Error: {} has {} colorings, but the ring has {}", fileName, feasible.size(), RingColorings(conf.ring_size).size());
+            throw std::runtime_error("Error reading " + fileName);
+        }
+        return feasible;
+    }
+    FeasibleFile file(fileName);
+    file.Check(FeasibleFileHeaderFor(conf, type), fileName);
+    if (file.Header().flags & feasibleRotated) {
+        spdlog::critical("Error: {} holds the feasibility merged over ring rotations (--rotate-f) and cannot be read back", fileName);
+        throw std::runtime_error("Error reading " + fileName);
+    }
+    return file.Bits();
+}
 
-void CheckCReducibility(CubicConf& conf, const vector<bool> &feasible, HaltType haltType, int minCont, int maxCont) {
-    auto colorings = LoadColorFile(conf.ring_size);
-    int colorNum = colorings.size();
-    spdlog::info("Started C-reducibility check");
-    bool isCReducible = false;
+// feasible file を出力する (拡張子が .bin ならバイナリで、kempeIndexes があれば途中状態も含める)
+template <Configuration Conf>
+void WriteFeasiblesFor(const Conf& conf, KempeType type, const string& fileName, const vector<bool>& feasible, const vector<vector<int>>* kempeIndexes, bool rotated = false) {
+    if (!IsBinaryFeasibleFile(fileName)) {
+        WriteFeasibles(feasible, fileName);
+        return;
+    }
+    auto header = FeasibleFileHeaderFor(conf, type);
+    header.flags = rotated ? feasibleRotated : 0;
+    WriteFeasibleFile(fileName, header, feasible, rotated ? nullptr : kempeIndexes);
+}
 
+// 縮約方法を列挙し、(縮約する辺の個数, exists) の組を縮約する辺の個数の昇順に並べて返す
+vector<pair<int, vector<bool>>> GetSortedContractions(const CubicConf& conf, int minCont, int maxCont) {
+    PhaseTimer phase("contraction enumeration");
     auto existsList = conf.GetGoodContractions(minCont, maxCont);
     vector<pair<int, vector<bool>>> existsCount(existsList.size());
     std::transform(existsList.begin(), existsList.end(), existsCount.begin(), [](const vector<bool>& v) {
         return std::make_pair(std::count(v.begin(), v.end(), false), v);
     });
     std::sort(existsCount.begin(), existsCount.end(), [](auto& v1, auto& v2) {return v1.first < v2.first;});
-    std::transform(existsCount.begin(), existsCount.end(), existsList.begin(), [](const auto& v) {return v.second;});
-    
-    spdlog::info("Trying {} possible contractions", existsList.size());
+    return existsCount;
+}
+
+// exists から縮約する辺の番号の一覧を得る
+vector<int> ContractEdgesOf(const vector<bool>& exists) {
+    vector<int> contractEdges;
+    for (int i = 0; i < (int)exists.size(); i++) {
+        if (!exists[i]) {
+            contractEdges.push_back(i);
+        }
+    }
+    return contractEdges;
+}
+
+// 同じ大きさの contraction の中で、成功しそうなものから順に試すような existsCount の添字の順列を返す (大きさの順序は変えない)
+// D-infeasible な Coloring をいくつか probe として選び、probe のどれかに拡張できる contraction は失敗が確定するので後回しにする
+// probe をすべて通過したもの同士では、リングに隣接する縮約辺が多いものを優先する
+// knownBad には、各 contraction について probe により失敗が確定しているかを格納する
+vector<int> PrioritizeContractions(const CubicConf& conf, const ColoringTable& colorings, const vector<bool>& feasible, const vector<pair<int, vector<bool>>>& existsCount, vector<bool>& knownBad) {
+    constexpr int maxProbeNum = 8;
+    vector<int> infeasibles;
+    for (int i = 0; i < (int)colorings.size(); i++) {
+        if (!feasible[i]) infeasibles.push_back(i);
+    }
+    int probeNum = std::min(maxProbeNum, (int)infeasibles.size());
+    vector<Coloring> probes;
+    for (int k = 0; k < probeNum; k++) {
+        probes.push_back(colorings.At(infeasibles[(size_t)k * infeasibles.size() / probeNum]));
+    }
+    vector<int> ringAdjacent(existsCount.size());
+    knownBad.assign(existsCount.size(), false);
+    for (int i = 0; i < (int)existsCount.size(); i++) {
+        auto& exists = existsCount[i].second;
+        for (auto& probe : probes) {
+            if (conf.CanColorWith(probe, exists)) {
+                knownBad[i] = true;
+                break;
+            }
+        }
+        ringAdjacent[i] = conf.CountRingAdjacent(exists);
+    }
+    vector<int> order(existsCount.size());
+    for (int i = 0; i < (int)order.size(); i++) order[i] = i;
+    for (int l = 0, r = 0; l < (int)order.size(); l = r) {
+        while (r < (int)order.size() && existsCount[r].first == existsCount[l].first) r++;
+        std::stable_sort(order.begin() + l, order.begin() + r, [&](int a, int b) {
+            if (knownBad[a] != knownBad[b]) return !knownBad[a];
+            return ringAdjacent[a] > ringAdjacent[b];
+        });
+        int knownBadCount = std::count_if(order.begin() + l, order.begin() + r, [&](int a) { return knownBad[a]; });
+        spdlog::debug("Size {}: {} / {} contractions rejected by {} probes", existsCount[l].first, knownBadCount, r - l, probeNum);
+    }
+    return order;
+}
+
+// EvaluateContractions の途中状態 (checkpoint から再開するのに使う)
+struct ContractionLoopState {
+    int position = 0; // 試す順に並べた contraction のうち、処理し終えた個数
     int contCount = 0;
     int maxContSize = 0;
     int lastContSize = 0;
-    for (auto &[contSize, exists] : existsCount) {
+    optional<vector<int>> firstSuccess;
+};
+
+// existsCount の contraction を (大きさの昇順に) 試し、最初に成功した contraction の縮約する辺を返す
+// contFeasibleOf(index, contractEdges) は existsCount[index] の contraction で拡張可能な Coloring を返す
+// resume が与えられた場合はその状態から続け、checkpoint が与えられた場合は contraction を 1 つ処理するごとにその時点の状態で呼び出す
+optional<vector<int>> EvaluateContractions(const CubicConf& conf, const ColoringTable& colorings, const vector<bool> &feasible, 
+    const vector<pair<int, vector<bool>>>& existsCount, HaltType haltType, bool prioritize,
+    const std::function<vector<bool>(int, const vector<int>&)>& contFeasibleOf,
+    const ContractionLoopState* resume = nullptr, const std::function<void(const ContractionLoopState&)>& checkpoint = nullptr) {
+    int colorNum = colorings.size();
+    vector<bool> knownBad(existsCount.size(), false);
+    vector<int> order(existsCount.size());
+    for (int i = 0; i < (int)order.size(); i++) order[i] = i;
+    if (prioritize) {
+        order = PrioritizeContractions(conf, colorings, feasible, existsCount, knownBad);
+    }
+    
+    spdlog::info("Trying {} possible contractions", existsCount.size());
+    std::map<int, int> sizeCount; // 大きさごとの contraction の個数 (途中経過の表示に使う)
+    for (auto& [contSize, exists] : existsCount) sizeCount[contSize]++;
+    ContractionLoopState loop = resume ? *resume : ContractionLoopState();
+    auto& firstSuccess = loop.firstSuccess;
+    auto& contCount = loop.contCount;
+    auto& maxContSize = loop.maxContSize;
+    auto& lastContSize = loop.lastContSize;
+    bool isCReducible = firstSuccess.has_value();
+    if (resume) {
+        spdlog::info("[{}/{}] Resuming contractions of size {}", contCount, existsCount.size(), maxContSize);
+    }
+    Progress::SetContractions(contCount, existsCount.size());
+    std::optional<PhaseTimer> sizePhase; // 大きさごとの区間
+    for (; loop.position < (int)order.size(); loop.position++) {
+        if (checkpoint && loop.position > 0) checkpoint(loop);
+        Budget::Poll();
+        int index = order[loop.position];
+        auto &[contSize, exists] = existsCount[index];
         if (isCReducible && contSize > lastContSize && haltType == HaltAfterSameSize) {
             break;
         }
-        vector<int> contractEdges;
-        for (int i = 0; i < (int)exists.size(); i++) {
-            if (!exists[i]) {
-                contractEdges.push_back(i);
-            }
-        }
+        auto contractEdges = ContractEdgesOf(exists);
         if (contractEdges.empty()) continue;
         if (maxContSize < contSize) {
             maxContSize = contSize;
-            spdlog::info("[{}/{}] Starting contraction of size {}", contCount, existsList.size(), contSize);
+            spdlog::info("[{}/{}] Starting contraction of size {}", contCount, existsCount.size(), contSize);
+            sizePhase.reset();
+            sizePhase.emplace(fmt::format("C size {}", contSize));
+            Progress::Start(fmt::format("C size {}", contSize), sizeCount[contSize], "contractions");
         }
-        spdlog::debug("[{}/{}] Contracting: {}", contCount, existsList.size(), fmt::join(contractEdges, ", "));
-        auto contFeasible = conf.CheckColorability(colorings, contractEdges);
-        bool badColoringExists = false;
-        for (int i = 0; i < colorNum; i++) {
-            if (contFeasible[i]) {
-                spdlog::trace("[{}/{}] {} -> {}", i, colorNum, colorings[i].StringOf(), feasible[i]);
-                if(!feasible[i]) {
-                    badColoringExists = true;
-                    break;
+        Budget::RecordContractions(contCount, existsCount.size(), maxContSize);
+        spdlog::debug("[{}/{}] Contracting: {}", contCount, existsCount.size(), fmt::join(contractEdges, ", "));
+        bool badColoringExists = knownBad[index];
+        if (!badColoringExists) {
+            auto contFeasible = contFeasibleOf(index, contractEdges);
+            for (int i = 0; i < colorNum; i++) {
+                if (contFeasible[i]) {
+                    spdlog::trace("[{}/{}] {} -> {}", i, colorNum, colorings[i], feasible[i]);
+                    if(!feasible[i]) {
+                        badColoringExists = true;
+                        break;
+                    }
                 }
             }
         }
         if (badColoringExists) {
             spdlog::debug("Bad color exists");
+            Metrics::Add(ContractionsRejected);
         }
         else {
             spdlog::info("All colors passed! Contracted: {}", fmt::join(contractEdges, ", "));
+            if (!isCReducible) {
+                firstSuccess = contractEdges;
+            }
             isCReducible = true;
             if (haltType == HaltImmediately) {
                 break;
@@ -236,6 +632,8 @@ void CheckCReducibility(CubicConf& conf, const vector<bool> &feasible, HaltType
         }
         lastContSize = contSize;
         contCount++;
+        Progress::Advance();
+        Progress::SetContractions(contCount, existsCount.size());
     }
     if (isCReducible) {
         spdlog::info("Graph is C-reducible!");
@@ -243,38 +641,267 @@ void CheckCReducibility(CubicConf& conf, const vector<bool> &feasible, HaltType
     else {
         spdlog::info("Graph is not C-reducible.");
     }
+    return firstSuccess;
 }
 
-vector<bool> RotatedFeasibles(vector<bool> feasible, int ring_size) {
-    auto colorings = LoadColorFile(ring_size);
-    int colorNum = colorings.size();
-    unordered_map<Coloring, int> coloringRev;
-    for (int i = 0; i < colorNum; i++) {
-        coloringRev[colorings[i]] = i;
+optional<vector<int>> CheckCReducibility(CubicConf& conf, const vector<bool> &feasible, HaltType haltType, int minCont, int maxCont, bool prioritize, ColorabilityCache* cache,
+    const ContractionLoopState* resume = nullptr, const std::function<void(const ContractionLoopState&)>& checkpoint = nullptr) {
+    auto colorings = RingColorings(conf.ring_size);
+    spdlog::info("Started C-reducibility check");
+    Progress::Start("contraction enumeration", 0, "contractions");
+    auto existsCount = GetSortedContractions(conf, minCont, maxCont);
+    return EvaluateContractions(conf, colorings, feasible, existsCount, haltType, prioritize, [&](int, const vector<int>& contractEdges) {
+        return CheckColorabilityCached(conf, colorings, contractEdges, cache);
+    }, resume, checkpoint);
+}
+
+// 縮約方法の列挙と、各 contraction で拡張可能な Coloring の計算を、別スレッドで先に進めておく
+// (D-reducibility check の結果に依存しないので、D-reducibility check と並行して行える)
+// 作ったスレッドの Budget を各スレッドでも使い、予算を超えるなどの例外は待っている側で投げ直す
+class ContractionPipeline {
+    vector<pair<int, vector<bool>>> existsCount;
+    vector<vector<bool>> contFeasibles;
+    vector<bool> isReady;
+    bool enumerated = false;
+    bool cancelled = false;
+    std::exception_ptr error;
+    int nextIndex = 0;
+    std::mutex mtx;
+    std::condition_variable cv;
+    vector<std::thread> workers;
+    Budget* budget = Budget::Current();
+
+    // スレッドで投げられた例外を記録して、ほかのスレッドを止める
+    template <typename F>
+    void Guarded(F&& f) {
+        Budget::Scope scope(budget);
+        try {
+            f();
+        }
+        catch (...) {
+            {
+                std::lock_guard lock(mtx);
+                if (!error) error = std::current_exception();
+                cancelled = true;
+            }
+            cv.notify_all();
+        }
     }
-    vector<bool> res(feasible.size());
-    for (int i = 0; i < colorNum; i++) {
-        if (feasible[i]) {
-            string tmp = colorings[i].StringOf();
-            for (int j = 0; j < ring_size; j++) {
-                auto color = Coloring::GetLexicalMin(tmp);
-                res[coloringRev.at(color)] = true;
-                tmp = tmp.substr(1) + tmp[0];
+    void RethrowIfFailed() {
+        if (error) std::rethrow_exception(error);
+    }
+
+    void Work(const CubicConf& conf, const ColoringTable& colorings, ColorabilityCache* cache) {
+        while (true) {
+            int index;
+            vector<int> contractEdges;
+            {
+                std::unique_lock lock(mtx);
+                cv.wait(lock, [&] { return enumerated || cancelled; });
+                if (cancelled || nextIndex >= (int)existsCount.size()) return;
+                index = nextIndex++;
+                contractEdges = ContractEdgesOf(existsCount[index].second);
+            }
+            auto contFeasible = contractEdges.empty() ? vector<bool>() : CheckColorabilityCached(conf, colorings, contractEdges, cache);
+            {
+                std::lock_guard lock(mtx);
+                contFeasibles[index] = std::move(contFeasible);
+                isReady[index] = true;
+            }
+            cv.notify_all();
+        }
+    }
+public:
+    ContractionPipeline(const CubicConf& conf, const ColoringTable& colorings, int minCont, int maxCont, int threadNum, ColorabilityCache* cache) {
+        threadNum = std::max(threadNum, 1);
+        workers.emplace_back([this, &conf, &colorings, minCont, maxCont, cache] {
+            Guarded([&] {
+                auto list = GetSortedContractions(conf, minCont, maxCont);
+                {
+                    std::lock_guard lock(mtx);
+                    existsCount = std::move(list);
+                    contFeasibles.resize(existsCount.size());
+                    isReady.assign(existsCount.size(), false);
+                    enumerated = true;
+                }
+                cv.notify_all();
+                Work(conf, colorings, cache);
+            });
+        });
+        for (int t = 1; t < threadNum; t++) {
+            workers.emplace_back([this, &conf, &colorings, cache] { Guarded([&] { Work(conf, colorings, cache); }); });
+        }
+    }
+    ~ContractionPipeline() {
+        {
+            std::lock_guard lock(mtx);
+            cancelled = true;
+        }
+        cv.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+    // 縮約方法の一覧 (列挙が終わるまで待つ)
+    const vector<pair<int, vector<bool>>>& Contractions() {
+        std::unique_lock lock(mtx);
+        cv.wait(lock, [&] { return enumerated || error; });
+        RethrowIfFailed();
+        return existsCount;
+    }
+    // existsCount[index] の contraction で拡張可能な Coloring (計算が終わるまで待つ)
+    vector<bool> ContFeasibleOf(int index) {
+        std::unique_lock lock(mtx);
+        cv.wait(lock, [&] { return (enumerated && isReady[index]) || error; });
+        RethrowIfFailed();
+        return contFeasibles[index];
+    }
+    // 計算済みの contraction のうち、拡張可能な Coloring がすべて feasible であるものを (大きさの昇順に探して) 返す
+    optional<vector<int>> FindSatisfied(const vector<bool>& feasible) {
+        std::lock_guard lock(mtx);
+        if (!enumerated) return std::nullopt;
+        for (int index = 0; index < (int)existsCount.size(); index++) {
+            if (!isReady[index] || contFeasibles[index].empty()) continue;
+            auto& contFeasible = contFeasibles[index];
+            bool badColoringExists = false;
+            for (int i = 0; i < (int)feasible.size(); i++) {
+                if (contFeasible[i] && !feasible[i]) {
+                    badColoringExists = true;
+                    break;
+                }
             }
+            if (!badColoringExists) return ContractEdgesOf(existsCount[index].second);
+        }
+        return std::nullopt;
+    }
+};
+
+// D-reducibility check と contraction ごとの計算を並行して行う
+// haltType が HaltImmediately の場合は、D-reducibility check の途中でも、ある contraction で拡張可能な Coloring がすべて feasible になれば停止する
+template <Configuration Conf>
+ReducibilityResult CheckPipelined(Conf& conf, KempeType type, HaltType haltType, int minCont, int maxCont, bool prioritize, int threadNum, bool useSymmetry, ColorabilityCache* cache) {
+    DReducibilityChecker<Conf> checker(conf, type);
+    if (useSymmetry) {
+        checker.UseSymmetry(conf);
+    }
+    auto& colorings = checker.Colorings();
+    std::optional<ContractionPipeline> pipeline;
+    if (!checker.IsDReducible()) {
+        pipeline.emplace(conf, colorings, minCont, maxCont, threadNum, cache);
+    }
+    spdlog::info("Started D-reducibility check");
+    optional<vector<int>> earlySuccess;
+    bool completed = checker.ReduceToFixpoint([&] {
+        if (haltType == HaltImmediately && pipeline) {
+            earlySuccess = pipeline->FindSatisfied(checker.Feasible());
+        }
+        return earlySuccess.has_value();
+    });
+    if (!completed) {
+        spdlog::info("All colors passed! Contracted: {}", fmt::join(*earlySuccess, ", "));
+        spdlog::info("Graph is C-reducible!");
+        return {type, false, true, *earlySuccess};
+    }
+    auto feasibleHash = HashFeasibles(checker.Feasible());
+    if (checker.IsDReducible()) return {type, true, false, {}, feasibleHash};
+    spdlog::info("Started C-reducibility check");
+    auto contraction = EvaluateContractions(conf, colorings, checker.Feasible(), pipeline->Contractions(), haltType, prioritize, [&](int index, const vector<int>&) {
+        return pipeline->ContFeasibleOf(index);
+    });
+    return {type, false, contraction.has_value(), contraction.value_or(vector<int>()), feasibleHash};
+}
+
+// feasible な Coloring をリングの回転で移したものもすべて feasible とした列 (回転の作用の表で番号を移すだけで求める)
+vector<bool> RotatedFeasibles(const vector<bool>& feasible, int ring_size) {
+    auto& action = RingAction(ring_size);
+    int colorNum = feasible.size();
+    vector<bool> res(colorNum);
+    for (int k = 0; k < ring_size; k++) {
+        auto row = action.Row(k);
+        for (int i = 0; i < colorNum; i++) {
+            if (feasible[i]) res[row[i]] = true;
         }
     }
     return res;
 }
 
-void CheckCReducibilitySingleCase(CubicConf& conf, const vector<bool> &feasible, const vector<int> &edgeSet) {
+// goal-directed な D-reducibility check を行う
+// 大きさが maxCont 以下の contraction について拡張可能な Coloring を求め、そのうち infeasible なものだけを対象に update を繰り返す
+// ある contraction の拡張可能な Coloring がすべて feasible になった時点で C-reducible として、その contraction で縮約する辺を返す
+// 対象の Coloring が更新されなくなった場合は、すべての Coloring について不動点まで update を続けて std::nullopt を返す
+template <Configuration Conf>
+optional<vector<int>> CheckGoalDirected(DReducibilityChecker<Conf>& checker, const Conf& conf, int minCont, int maxCont, ColorabilityCache* cache) {
+    if (checker.IsDReducible()) {
+        checker.ReduceToFixpoint();
+        return std::nullopt;
+    }
+    auto& colorings = checker.Colorings();
+    int colorNum = checker.ColorNum();
+    auto existsCount = GetSortedContractions(conf, minCont, maxCont);
+    vector<pair<vector<int>, vector<int>>> goals; // (縮約する辺, 拡張可能かつ infeasible な Coloring)
+    vector<bool> isTarget(colorNum, false);
+    for (auto& [contSize, exists] : existsCount) {
+        auto contractEdges = ContractEdgesOf(exists);
+        if (contractEdges.empty()) continue;
+        auto contFeasible = CheckColorabilityCached(conf, colorings, contractEdges, cache);
+        vector<int> targets;
+        for (int i = 0; i < colorNum; i++) {
+            if (contFeasible[i] && !checker.Feasible()[i]) {
+                targets.push_back(i);
+                isTarget[i] = true;
+            }
+        }
+        goals.emplace_back(contractEdges, targets);
+    }
+    vector<int> targetIndexes;
+    for (int i = 0; i < colorNum; i++) {
+        if (isTarget[i]) targetIndexes.push_back(i);
+    }
+    auto reachedGoal = [&]() -> const vector<int>* {
+        for (auto& [contractEdges, targets] : goals) {
+            auto& feasible = checker.Feasible();
+            if (std::all_of(targets.begin(), targets.end(), [&](int i) { return feasible[i]; })) {
+                return &contractEdges;
+            }
+        }
+        return nullptr;
+    };
+    spdlog::info("Started goal-directed D-reducibility check");
+    spdlog::info("Targeting {} colorings from {} contractions of size {} to {}", targetIndexes.size(), goals.size(), minCont, maxCont);
+    int iterationCount = 0;
+    while (true) {
+        if (auto contractEdges = reachedGoal()) {
+            spdlog::info("All colors passed! Contracted: {}", fmt::join(*contractEdges, ", "));
+            spdlog::info("Graph is C-reducible!");
+            return *contractEdges;
+        }
+        int feasibleTargetCount = std::count_if(targetIndexes.begin(), targetIndexes.end(), [&](int i) { return checker.Feasible()[i]; });
+        spdlog::info("#{}: Feasible targets / Total targets: {} / {}", iterationCount + 1, feasibleTargetCount, targetIndexes.size());
+        Budget::RecordFeasible(iterationCount, checker.FeasibleCount(), colorNum);
+        int updateCount;
+        {
+            PhaseTimer phase(fmt::format("goal-directed D iteration {}", iterationCount + 1));
+            Progress::Start(fmt::format("goal-directed D iteration {}", iterationCount + 1), targetIndexes.size(), "colorings");
+            Progress::SetFeasible(checker.FeasibleCount(), colorNum);
+            updateCount = checker.Reduce(targetIndexes);
+        }
+        if (updateCount == 0) {
+            break;
+        }
+        iterationCount++;
+    }
+    spdlog::info("No contraction reached its targets, continuing the full D-reducibility check");
+    checker.ReduceToFixpoint();
+    return std::nullopt;
+}
+
+bool CheckCReducibilitySingleCase(CubicConf& conf, const vector<bool> &feasible, const vector<int> &edgeSet, ColorabilityCache* cache) {
     spdlog::info("Started C-reducibility check for edge set = [{}]", fmt::join(edgeSet, ", "));
-    auto colorings = LoadColorFile(conf.ring_size);
+    auto colorings = RingColorings(conf.ring_size);
     int colorNum = colorings.size();
-    auto contFeasible = conf.CheckColorability(colorings, edgeSet);
+    auto contFeasible = CheckColorabilityCached(conf, colorings, edgeSet, cache);
     bool badColoringExists = false;
     for (int i = 0; i < colorNum; i++) {
         if (contFeasible[i]) {
-            spdlog::trace("[{}/{}] {} -> {}", i, colorNum, colorings[i].StringOf(), feasible[i]);
+            spdlog::trace("[{}/{}] {} -> {}", i, colorNum, colorings[i], feasible[i]);
             if(!feasible[i]) {
                 badColoringExists = true;
                 break;
@@ -287,64 +914,461 @@ void CheckCReducibilitySingleCase(CubicConf& conf, const vector<bool> &feasible,
     else {
         spdlog::info("Graph is C-reducible!");
     }
+    return !badColoringExists;
+}
+
+void LogSummary(const vector<ReducibilityResult>& results) {
+    spdlog::info("Summary:");
+    for (auto& result : results) {
+        if (result.isDReducible) {
+            spdlog::info("{}: D-reducible", KempeTypeName(result.type));
+        }
+        else if (result.isCReducible) {
+            spdlog::info("{}: C-reducible (Contracted: {})", KempeTypeName(result.type), fmt::join(result.contraction, ", "));
+        }
+        else {
+            spdlog::info("{}: not reducible", KempeTypeName(result.type));
+        }
+    }
 }
 
+// 4 種類の Kempe type すべてについて判定する
+// Kempe type に依存しない部分 (Coloring の読み込み、初期の彩色判定、contraction の列挙と contraction ごとの彩色判定) は一度だけ計算する
+// Kempe chain の集合は Planar ⊆ Apex ⊆ Toroidal, Planar ⊆ Projective なので、feasible な Coloring の集合はこの逆の包含関係になる
+// そこで Toroidal, Apex, Projective, Planar の順に判定し、feasible と分かった Coloring を後の判定の初期値として使う
+vector<ReducibilityResult> CheckAllTypes(CubicConf& conf, const EvaluateOptions& options, int minCont, int maxCont, ColorabilityCache* cache) {
+    auto colorings = DReducibilityChecker<CubicConf>::LoadRingColorings(conf);
+    vector<bool> initialFeasible;
+    {
+        PhaseTimer phase("initial colorability");
+        initialFeasible = conf.CheckColorability(colorings, {}, false);
+    }
+    std::map<KempeType, vector<bool>> feasibles;
+    vector<ReducibilityResult> results;
+    for (auto type : {Toroidal, Apex, Projective, Planar}) {
+        spdlog::info("Kempe type: {}", KempeTypeName(type));
+        DReducibilityChecker<CubicConf> checker(conf, type, colorings, initialFeasible);
+        if (options.useSymmetry) {
+            checker.UseSymmetry(conf);
+        }
+        if (type == Apex) {
+            checker.WarmStart(feasibles.at(Toroidal));
+        }
+        if (type == Planar) {
+            checker.WarmStart(feasibles.at(Apex));
+            checker.WarmStart(feasibles.at(Projective));
+        }
+        spdlog::info("Started D-reducibility check");
+        checker.ReduceToFixpoint();
+        feasibles[type] = checker.Feasible();
+        results.push_back({type, checker.IsDReducible(), false, {}, HashFeasibles(checker.Feasible())});
+    }
+    // contraction ごとの彩色判定は Kempe type に依存しないので、一度計算したものを使い回す
+    vector<pair<int, vector<bool>>> existsCount;
+    vector<optional<vector<bool>>> contFeasibles;
+    bool enumerated = false;
+    for (auto& result : results) {
+        if (result.isDReducible) continue;
+        auto& feasible = feasibles.at(result.type);
+        spdlog::info("Kempe type: {}", KempeTypeName(result.type));
+        if (options.hasEdgeSet) {
+            spdlog::info("Started C-reducibility check for edge set = [{}]", fmt::join(options.edgeSet, ", "));
+            result.isCReducible = CheckCReducibilitySingleCase(conf, feasible, options.edgeSet, cache);
+            if (result.isCReducible) result.contraction = options.edgeSet;
+            continue;
+        }
+        spdlog::info("Started C-reducibility check");
+        if (!enumerated) {
+            Progress::Start("contraction enumeration", 0, "contractions");
+            existsCount = GetSortedContractions(conf, minCont, maxCont);
+            contFeasibles.resize(existsCount.size());
+            enumerated = true;
+        }
+        auto contraction = EvaluateContractions(conf, colorings, feasible, existsCount, options.haltType, options.prioritize, [&](int index, const vector<int>& contractEdges) {
+            if (!contFeasibles[index]) {
+                contFeasibles[index] = CheckColorabilityCached(conf, colorings, contractEdges, cache);
+            }
+            return *contFeasibles[index];
+        });
+        if (contraction) {
+            result.isCReducible = true;
+            result.contraction = *contraction;
+        }
+    }
+    LogSummary(results);
+    return results;
+}
+
+// conf を options で判定するときの checkpoint のヘッダ (判定の条件の欄だけを埋めたもの)
 template <Configuration Conf>
-void EvaluateConf(string confFile, KempeType type, HaltType haltType, int minContOp, int maxContOp, string feasibleFile, bool readFromFeasible, bool writeToFeasible, bool rotateColoringOfFeasible, bool outputWithoutDReducibleCheck, bool hasEdgeSet, const vector<int> &edgeSet, bool isAnnular) {
-    ifstream ifs(confFile);
-    if (!ifs) {
-        spdlog::error("Failed to read {}", confFile);
-        return;
+CheckpointHeader CheckpointHeaderFor(const Conf& conf, const EvaluateOptions& options, int minCont, int maxCont) {
+    CheckpointHeader header = {};
+    header.feasible = FeasibleFileHeaderFor(conf, options.type);
+    header.minCont = minCont;
+    header.maxCont = maxCont;
+    header.haltType = options.haltType;
+    header.flags = (options.prioritize ? checkpointPrioritize : 0) | (options.useSymmetry ? checkpointSymmetry : 0);
+    return header;
+}
+
+// 読み込んだ configuration を options に従って判定する (EvaluateConf の本体)
+template <Configuration Conf>
+vector<ReducibilityResult> EvaluateLoadedConf(Conf& conf, const EvaluateOptions& options, int minCont, int maxCont, bool onlyReducibility) {
+    std::unique_ptr<ColorabilityCache> cache;
+    if (!options.cacheDir.empty()) {
+        cache = std::make_unique<ColorabilityCache>(options.cacheDir, conf, RingColorings(conf.ring_size));
     }
-    if (isAnnular) {
-        spdlog::info("Kempe type: Annular");
+    if constexpr (std::same_as<Conf, CubicConf>) {
+        if (options.allTypes) {
+            return CheckAllTypes(conf, options, minCont, maxCont, cache.get());
+        }
     }
-    else {
-        switch (type) {
-            case Planar: 
-                spdlog::info("Kempe type: Planar");
-                break;
-            case Apex: 
-                spdlog::info("Kempe type: Apex");
-                break;
-            case Projective: 
-                spdlog::info("Kempe type: Projective");
-                break;
-            case Toroidal: 
-                spdlog::info("Kempe type: Toroidal");
-                break;
+    bool goalDirected = options.goalContMax > 0 && onlyReducibility;
+    if (options.pipelined && onlyReducibility && !goalDirected) {
+        return {CheckPipelined(conf, options.type, options.haltType, minCont, maxCont, options.prioritize, options.threadNum, options.useSymmetry, cache.get())};
+    }
+    std::unique_ptr<Checkpointer> checkpointer;
+    optional<CheckpointState> resumed;
+    if (!options.checkpointDir.empty()) {
+        if (options.confName.empty()) {
+            spdlog::warn("No checkpoint is written for a configuration without a file name");
+        }
+        else {
+            checkpointer = std::make_unique<Checkpointer>(CheckpointFileName(options.checkpointDir, options.confName), options.checkpointInterval, CheckpointHeaderFor(conf, options, minCont, maxCont));
+            if (options.resume) {
+                resumed = checkpointer->Load();
+                if (!resumed) spdlog::info("No checkpoint found at {}, starting from the beginning", checkpointer->FileName());
+            }
         }
     }
-    if (hasEdgeSet) {
-        spdlog::info("Checking for edge set: [{}]", fmt::join(edgeSet, ", "));
+    vector<bool> feasible;
+    vector<vector<int>> kempeIndexes;
+    if (resumed && resumed->stage == checkpointC) {
+        spdlog::info("Resuming the C-reducibility check from {}", checkpointer->FileName());
+        feasible = resumed->feasible;
+        spdlog::info("Feasible / Total: {} / {}", std::count(feasible.begin(), feasible.end(), true), feasible.size());
     }
-    Conf conf = Conf::fromFile(ifs);
-    // std::optional<pair<size_t, size_t>> annularRing = isAnnular ? std::make_optional(conf.annular_ring) : std::nullopt; 
-    auto feasible = readFromFeasible ? LoadFeasibles(feasibleFile) : CheckDReducibility(conf, type, outputWithoutDReducibleCheck);
-    if (outputWithoutDReducibleCheck) {
-        WriteFeasibles(feasible, feasibleFile);
-        return;
+    else if (options.readFromFeasible) {
+        feasible = LoadFeasiblesFor(conf, options.type, options.feasibleFile);
+    }
+    else if (goalDirected) {
+        DReducibilityChecker<Conf> checker(conf, options.type);
+        if (options.useSymmetry) {
+            checker.UseSymmetry(conf);
+        }
+        if (auto contraction = CheckGoalDirected(checker, conf, minCont, std::min(maxCont, options.goalContMax), cache.get())) {
+            return {{options.type, false, true, *contraction}};
+        }
+        feasible = checker.Feasible();
+    }
+    else {
+        optional<vector<bool>> initialFeasible;
+        if (resumed) initialFeasible = resumed->feasible;
+        DReducibilityChecker<Conf> checker(conf, options.type, DReducibilityChecker<Conf>::LoadRingColorings(conf), initialFeasible);
+        if (resumed) {
+            checker.Restore(resumed->feasible, resumed->kempeIndexes);
+            checker.ResumeSweep(resumed->iteration, resumed->sweepPosition, resumed->sweepUpdateCount);
+            spdlog::info("Resuming the D-reducibility check from {} (iteration {}, {} colorings done)", checkpointer->FileName(), resumed->iteration + 1, resumed->sweepPosition);
+        }
+        if (checkpointer) {
+            checker.SetCheckpoint([&] {
+                if (!checkpointer->Due()) return;
+                CheckpointState state;
+                state.stage = checkpointD;
+                state.feasible = checker.Feasible();
+                state.kempeIndexes = checker.KempeIndexes();
+                state.iteration = checker.IterationCount();
+                state.sweepPosition = checker.SweepPosition();
+                state.sweepUpdateCount = checker.SweepUpdateCount();
+                checkpointer->Write(state);
+            });
+        }
+        if (options.warmStartFromFeasible) {
+            FeasibleFile warm(options.feasibleFile);
+            warm.Check(FeasibleFileHeaderFor(conf, options.type), options.feasibleFile);
+            auto warmKempeIndexes = warm.KempeIndexes();
+            if ((warm.Header().flags & feasibleRotated) || !warmKempeIndexes) {
+                spdlog::critical("Error: {} does not hold the state of a D-reducibility check", options.feasibleFile);
+                throw std::runtime_error("Error reading " + options.feasibleFile);
+            }
+            checker.Restore(warm.Bits(), *warmKempeIndexes);
+            spdlog::info("Resuming the D-reducibility check from {} ({} feasible)", options.feasibleFile, checker.FeasibleCount());
+        }
+        feasible = CheckDReducibility(checker, conf, options.outputWithoutDReducibleCheck, options.useSymmetry);
+        kempeIndexes = checker.KempeIndexes();
+    }
+    if (options.outputWithoutDReducibleCheck) {
+        WriteFeasiblesFor(conf, options.type, options.feasibleFile, feasible, &kempeIndexes);
+        return {};
     }
-    if (writeToFeasible) {
-        if (rotateColoringOfFeasible) {
+    if (options.writeToFeasible) {
+        if (options.rotateColoringOfFeasible) {
             auto rotatedFeasible = RotatedFeasibles(feasible, conf.ring_size);
-            WriteFeasibles(rotatedFeasible, feasibleFile);
+            WriteFeasiblesFor(conf, options.type, options.feasibleFile, rotatedFeasible, nullptr, true);
         }
         else {
-            WriteFeasibles(feasible, feasibleFile);
+            WriteFeasiblesFor(conf, options.type, options.feasibleFile, feasible, kempeIndexes.empty() ? nullptr : &kempeIndexes);
         }
     }
+    ReducibilityResult result = {options.type, true, false, {}, HashFeasibles(feasible)};
     for (auto f : feasible) {
         if (!f) {
-            int minCont = minContOp;
-            int maxCont = maxContOp <= 0 ? conf.edge_size : maxContOp;
-            if (hasEdgeSet) {
-                CheckCReducibilitySingleCase(conf, feasible, edgeSet);
+            result.isDReducible = false;
+            if (options.hasEdgeSet) {
+                result.isCReducible = CheckCReducibilitySingleCase(conf, feasible, options.edgeSet, cache.get());
+                if (result.isCReducible) result.contraction = options.edgeSet;
             }
             else {
-                CheckCReducibility(conf, feasible, haltType, minCont, maxCont);
+                // C-reducibility check の状態 (D-reducibility check の結果を含む) を checkpoint に書く
+                auto writeCheckpoint = [&](const ContractionLoopState& loop) {
+                    CheckpointState state;
+                    state.stage = checkpointC;
+                    state.feasible = feasible;
+                    state.contPosition = loop.position;
+                    state.contCount = loop.contCount;
+                    state.maxContSize = loop.maxContSize;
+                    state.lastContSize = loop.lastContSize;
+                    state.firstSuccess = loop.firstSuccess;
+                    checkpointer->Write(state);
+                };
+                optional<ContractionLoopState> resumedLoop;
+                if (resumed && resumed->stage == checkpointC) {
+                    resumedLoop = ContractionLoopState{resumed->contPosition, resumed->contCount, resumed->maxContSize, resumed->lastContSize, resumed->firstSuccess};
+                }
+                else if (checkpointer) {
+                    // D-reducibility check をやり直さずに済むように、C-reducibility check の前に必ず書く
+                    writeCheckpoint(ContractionLoopState());
+                }
+                std::function<void(const ContractionLoopState&)> checkpoint;
+                if (checkpointer) {
+                    checkpoint = [&](const ContractionLoopState& loop) {
+                        if (checkpointer->Due()) writeCheckpoint(loop);
+                    };
+                }
+                auto contraction = CheckCReducibility(conf, feasible, options.haltType, minCont, maxCont, options.prioritize, cache.get(), resumedLoop ? &*resumedLoop : nullptr, checkpoint);
+                result.isCReducible = contraction.has_value();
+                result.contraction = contraction.value_or(vector<int>());
             }
             break;
         }
     }
-}
\ No newline at end of file
+    if (checkpointer) {
+        // 判定が終わったので、次に --resume しても最初からになるように消す
+        std::error_code error;
+        std::filesystem::remove(checkpointer->FileName(), error);
+    }
+    return {result};
+}
+
+// Kempe type が type のときに同一視してよいリングの対称性 (回転, 反転) で求めた標準形
+// Kempe chain の集合が閉じていない対称性は使わない
+CubicConf::CanonicalForm CanonicalFormFor(const CubicConf& conf, KempeType type) {
+    bool useReflections = !FirstKempeSizeNotClosed(conf.ring_size, type, true);
+    bool useRotations = useReflections || !FirstKempeSizeNotClosed(conf.ring_size, type, false);
+    return conf.Canonicalize(useRotations, useReflections);
+}
+
+// verdict cache にある判定結果を、入力の辺の番号に直して返す (なければ std::nullopt)
+optional<ReducibilityResult> FindCachedVerdict(VerdictCache& verdictCache, const CubicConf& conf, KempeType type, int minCont, int maxCont) {
+    auto canonical = CanonicalFormFor(conf, type);
+    auto verdict = verdictCache.Find(canonical.hash, KempeTypeName(type), minCont, maxCont);
+    if (!verdict) return std::nullopt;
+    vector<int> edgeOf(conf.edge_size);
+    for (int e = 0; e < conf.edge_size; e++) edgeOf[canonical.edgeLabel[e]] = e;
+    ReducibilityResult result = {type, verdict->kind == 'D', verdict->kind == 'C', {}};
+    for (int e : verdict->contraction) result.contraction.push_back(edgeOf.at(e));
+    std::sort(result.contraction.begin(), result.contraction.end());
+    return result;
+}
+
+void StoreVerdict(VerdictCache& verdictCache, const CubicConf& conf, const ReducibilityResult& result, int minCont, int maxCont) {
+    auto canonical = CanonicalFormFor(conf, result.type);
+    VerdictCache::Verdict verdict = {result.isDReducible ? 'D' : result.isCReducible ? 'C' : 'N', {}};
+    for (int e : result.contraction) verdict.contraction.push_back(canonical.edgeLabel[e]);
+    verdictCache.Store(canonical.hash, KempeTypeName(result.type), minCont, maxCont, verdict);
+}
+
+// 判定に成功した結果を証明書にする (成功した結果がなければ std::nullopt)
+optional<Certificate> CertificateOf(const CubicConf& conf, const vector<ReducibilityResult>& results) {
+    Certificate certificate;
+    certificate.confHash = conf.Hash();
+    certificate.coloringHash = HashColorings(RingColorings(conf.ring_size));
+    for (auto& result : results) {
+        if (result.isDReducible) {
+            certificate.entries.push_back({result.type, 'D', result.feasibleHash, {}});
+        }
+        else if (result.isCReducible) {
+            certificate.entries.push_back({result.type, 'C', result.feasibleHash, result.contraction});
+        }
+    }
+    if (certificate.entries.empty()) return std::nullopt;
+    return certificate;
+}
+
+// 証明書 certificate を再検証する (一致しない場合は例外を投げる)
+// Kempe type ごとに D-reducibility check を不動点まで行い、feasible のハッシュ値と、記録された contraction 1 つだけを確かめる
+// threadNum が 2 以上なら、contraction で拡張可能な Coloring の計算は D-reducibility check と並行して行う
+vector<ReducibilityResult> VerifyCertificate(CubicConf& conf, const Certificate& certificate, const string& fileName, int threadNum) {
+    auto fail = [&](const string& reason) {
+        spdlog::critical("Error: Certificate {} does not hold: {}", fileName, reason);
+        throw std::runtime_error("Certificate verification failed for " + fileName);
+    };
+    if (certificate.confHash != conf.Hash()) fail("it was written for a different configuration");
+    auto colorings = RingColorings(conf.ring_size);
+    if (certificate.coloringHash != HashColorings(colorings)) fail("it was written with a different coloring table (color/)");
+    vector<ReducibilityResult> results;
+    for (auto& entry : certificate.entries) {
+        spdlog::info("Kempe type: {}", KempeTypeName(entry.type));
+        std::future<vector<bool>> contFeasible;
+        if (entry.kind == 'C') {
+            if (!conf.IsGoodContraction(entry.contraction)) fail(fmt::format("[{}] is not a valid contraction", fmt::join(entry.contraction, ", ")));
+            spdlog::info("Checking the contraction [{}]", fmt::join(entry.contraction, ", "));
+            contFeasible = std::async(threadNum > 1 ? std::launch::async : std::launch::deferred, [&] {
+                return conf.CheckColorability(colorings, entry.contraction);
+            });
+        }
+        DReducibilityChecker<CubicConf> checker(conf, entry.type, colorings);
+        spdlog::info("Started D-reducibility check");
+        checker.ReduceToFixpoint();
+        auto& feasible = checker.Feasible();
+        auto feasibleHash = HashFeasibles(feasible);
+        if (entry.feasibleHash && *entry.feasibleHash != feasibleHash) {
+            fail(fmt::format("the feasible colorings of {} differ ({:016x} instead of {:016x})", KempeTypeName(entry.type), feasibleHash, *entry.feasibleHash));
+        }
+        if (entry.kind == 'D') {
+            if (!checker.IsDReducible()) fail(fmt::format("not D-reducible for {}", KempeTypeName(entry.type)));
+            results.push_back({entry.type, true, false, {}, feasibleHash});
+            continue;
+        }
+        auto extendable = contFeasible.get();
+        for (int i = 0; i < (int)colorings.size(); i++) {
+            if (extendable[i] && !feasible[i]) {
+                fail(fmt::format("{} extends to the contraction but is not feasible for {}", colorings[i], KempeTypeName(entry.type)));
+            }
+        }
+        spdlog::info("All colors passed! Contracted: {}", fmt::join(entry.contraction, ", "));
+        results.push_back({entry.type, false, true, entry.contraction, feasibleHash});
+    }
+    spdlog::info("Certificate verified: {}", fileName);
+    LogSummary(results);
+    return results;
+}
+
+// EvaluateConfFrom の本体 (予算は見ない)
+template <Configuration Conf>
+vector<ReducibilityResult> EvaluateConfWithoutBudget(const std::function<Conf()>& load, const EvaluateOptions& options) {
+    if (options.isAnnular) {
+        spdlog::info("Kempe type: Annular");
+    }
+    else if (!options.allTypes) {
+        spdlog::info("Kempe type: {}", KempeTypeName(options.type));
+    }
+    if (options.hasEdgeSet) {
+        spdlog::info("Checking for edge set: [{}]", fmt::join(options.edgeSet, ", "));
+    }
+    Conf conf = load();
+    if constexpr (std::same_as<Conf, CubicConf>) {
+        if (options.verifyCertificates) {
+            if (options.confName.empty()) {
+                spdlog::critical("Error: Certificates can only be verified for configurations given by file name");
+                throw std::runtime_error("No configuration name for the certificate");
+            }
+            auto fileName = CertificateFileName(options.certificateDir, options.confName);
+            return VerifyCertificate(conf, LoadCertificate(fileName), fileName, options.threadNum);
+        }
+    }
+    // std::optional<pair<size_t, size_t>> annularRing = isAnnular ? std::make_optional(conf.annular_ring) : std::nullopt; 
+    int minCont = options.minCont;
+    int maxCont = options.maxCont <= 0 ? conf.edge_size : options.maxCont;
+    bool onlyReducibility = !options.readFromFeasible && !options.writeToFeasible && !options.outputWithoutDReducibleCheck && !options.hasEdgeSet && !options.warmStartFromFeasible;
+    // 判定に成功した結果を証明書として出力する
+    auto writeCertificate = [&](const vector<ReducibilityResult>& results) {
+        if (options.certificateDir.empty() || !onlyReducibility) return;
+        if (options.confName.empty()) {
+            spdlog::warn("No certificate is written for a configuration without a file name");
+        }
+        else if (auto certificate = CertificateOf(conf, results)) {
+            WriteCertificate(CertificateFileName(options.certificateDir, options.confName), *certificate);
+        }
+    };
+    std::unique_ptr<VerdictCache> verdictCache;
+    if constexpr (std::same_as<Conf, CubicConf>) {
+        if (!options.verdictCacheDir.empty() && onlyReducibility) {
+            verdictCache = std::make_unique<VerdictCache>(options.verdictCacheDir);
+            auto types = options.allTypes ? vector<KempeType>{Toroidal, Apex, Projective, Planar} : vector<KempeType>{options.type};
+            vector<ReducibilityResult> cached;
+            for (auto type : types) {
+                if (auto result = FindCachedVerdict(*verdictCache, conf, type, minCont, maxCont)) cached.push_back(*result);
+            }
+            if (cached.size() == types.size()) {
+                spdlog::info("Found the verdict in the verdict cache");
+                if (options.allTypes) {
+                    LogSummary(cached);
+                }
+                else if (cached[0].isDReducible) {
+                    spdlog::info("Graph is D-reducible!");
+                }
+                else if (cached[0].isCReducible) {
+                    spdlog::info("All colors passed! Contracted: {}", fmt::join(cached[0].contraction, ", "));
+                    spdlog::info("Graph is C-reducible!");
+                }
+                else {
+                    spdlog::info("Graph is not D-reducible.");
+                    spdlog::info("Graph is not C-reducible.");
+                }
+                writeCertificate(cached);
+                return cached;
+            }
+        }
+    }
+    auto results = EvaluateLoadedConf(conf, options, minCont, maxCont, onlyReducibility);
+    if constexpr (std::same_as<Conf, CubicConf>) {
+        if (verdictCache) {
+            // goal-directed な check や pipeline で不動点に達する前に停止した結果は、D-reducible かどうかが決まっていないので保存しない
+            for (auto& result : results) {
+                if (result.feasibleHash) StoreVerdict(*verdictCache, conf, result, minCont, maxCont);
+            }
+        }
+        writeCertificate(results);
+    }
+    return results;
+}
+
+// load() で作った configuration を判定し、Kempe type ごとの判定結果を返す
+// feasible file の読み書きや edge set を指定した場合など、reducibility が決まらない場合の結果は空になる
+// 時間・メモリの予算を使い切った場合は途中経過をログに出して中断し、budgetExceeded を立てた結果を返す
+// (verdict cache や証明書には何も書かない、checkpoint は最後に書き出したものが残る)
+template <Configuration Conf>
+vector<ReducibilityResult> EvaluateConfFrom(const std::function<Conf()>& load, const EvaluateOptions& options) {
+    if (options.timeBudget <= 0 && options.memoryBudgetMb <= 0) {
+        return EvaluateConfWithoutBudget<Conf>(load, options);
+    }
+    Budget budget(options.timeBudget, options.memoryBudgetMb);
+    try {
+        Budget::Scope scope(&budget);
+        return EvaluateConfWithoutBudget<Conf>(load, options);
+    }
+    catch (const BudgetExceeded& e) {
+        spdlog::warn("Budget exceeded: {}", e.what());
+        spdlog::warn("Partial progress: {}", budget.ProgressSummary());
+        ReducibilityResult result = {options.type};
+        result.budgetExceeded = true;
+        return {result};
+    }
+}
+
+// 入力ストリーム is から configuration を読み込んで判定する
+template <Configuration Conf>
+vector<ReducibilityResult> EvaluateConf(std::istream& is, const EvaluateOptions& options) {
+    return EvaluateConfFrom<Conf>([&] { return Conf::fromFile(is); }, options);
+}
+
+template <Configuration Conf>
+vector<ReducibilityResult> EvaluateConf(string confFile, const EvaluateOptions& options) {
+    ifstream ifs(confFile);
+    if (!ifs) {
+        spdlog::critical("Error: Failed to read {}", confFile);
+        throw std::runtime_error("Error reading " + confFile);
+    }
+    return EvaluateConf<Conf>(ifs, options);
+}
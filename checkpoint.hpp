@@ -0,0 +1,183 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <optional>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+#include "feasibles.hpp"
+#include "mapped_file.hpp"
+
+using std::string;
+using std::vector;
+using std::optional;
+
+// 長い判定を途中から再開するための checkpoint (<dir>/<名前>.ckpt) の形式
+// ヘッダ、各 coloring が feasible かどうかの bitset (uint64 の列)、各 coloring, fix についてどの Kempe chain まで成功したか (int32 が colorNum * 3 個)、
+// C-reducibility check で最初に成功した contraction の縮約する辺 (int32 が successSize 個)、の順に並ぶ
+// 判定の条件 (configuration, Coloring の表, Kempe type, 縮約の範囲など) がヘッダと一致しない checkpoint からは再開しない
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t stage; // checkpointD または checkpointC
+    FeasibleFileHeader feasible; // configuration, Kempe type, Coloring の表 (FeasibleFileHeaderFor と同じ値、magic と stateOffset は使わない)
+    int32_t minCont;
+    int32_t maxCont;
+    uint32_t haltType;
+    uint32_t flags; // checkpointPrioritize, checkpointSymmetry
+    // D-reducibility check の途中状態
+    int32_t iteration; // 終えた update の回数
+    int32_t sweepPosition; // 途中の update で処理し終えた Coloring の個数
+    int32_t sweepUpdateCount; // 途中の update で feasible にできた Coloring の個数
+    // C-reducibility check の途中状態 (ContractionLoopState)
+    int32_t contPosition;
+    int32_t contCount;
+    int32_t maxContSize;
+    int32_t lastContSize;
+    int32_t successSize; // 最初に成功した contraction の縮約する辺の個数 (成功していなければ -1)
+};
+constexpr char checkpointMagic[8] = {'C', 'H', 'E', 'C', 'K', 'P', 'T', '1'};
+constexpr uint32_t checkpointVersion = 1;
+constexpr uint32_t checkpointD = 0;
+constexpr uint32_t checkpointC = 1;
+constexpr uint32_t checkpointPrioritize = 1;
+constexpr uint32_t checkpointSymmetry = 2;
+
+// checkpoint に保存する判定の途中状態
+struct CheckpointState {
+    uint32_t stage = checkpointD;
+    vector<bool> feasible;
+    vector<vector<int>> kempeIndexes;
+    int iteration = 0;
+    int sweepPosition = 0;
+    int sweepUpdateCount = 0;
+    int contPosition = 0;
+    int contCount = 0;
+    int maxContSize = 0;
+    int lastContSize = 0;
+    optional<vector<int>> firstSuccess;
+};
+
+string CheckpointFileName(const string& dir, const string& name) {
+    return (std::filesystem::path(dir) / (name + ".ckpt")).string();
+}
+
+// 一定間隔 (interval 秒) ごとに checkpoint を書き出す
+// expected は判定の条件を書いたヘッダ (途中状態の欄は Write のたびに埋める)
+class Checkpointer {
+    string fileName;
+    double interval;
+    CheckpointHeader expected;
+    std::chrono::steady_clock::time_point lastWrite = std::chrono::steady_clock::now();
+public:
+    Checkpointer(const string& fileName, double interval, const CheckpointHeader& expected) : fileName(fileName), interval(interval), expected(expected) {
+        std::memcpy(this->expected.magic, checkpointMagic, sizeof(checkpointMagic));
+        this->expected.version = checkpointVersion;
+    }
+    const string& FileName() const {
+        return fileName;
+    }
+    // 前回書き出してから interval 秒以上経ったか
+    bool Due() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - lastWrite).count() >= interval;
+    }
+    // 一時ファイルに書いてから rename するので、書き込み中に終了しても前回の checkpoint は残る
+    void Write(const CheckpointState& state) {
+        auto header = expected;
+        header.stage = state.stage;
+        header.feasible.colorNum = state.feasible.size();
+        header.iteration = state.iteration;
+        header.sweepPosition = state.sweepPosition;
+        header.sweepUpdateCount = state.sweepUpdateCount;
+        header.contPosition = state.contPosition;
+        header.contCount = state.contCount;
+        header.maxContSize = state.maxContSize;
+        header.lastContSize = state.lastContSize;
+        header.successSize = state.firstSuccess ? state.firstSuccess->size() : -1;
+        vector<uint64_t> words((state.feasible.size() + 63) / 64);
+        for (size_t i = 0; i < state.feasible.size(); i++) {
+            if (state.feasible[i]) words[i / 64] |= uint64_t(1) << (i % 64);
+        }
+        vector<int32_t> indexes;
+        indexes.reserve(state.feasible.size() * 3);
+        for (size_t i = 0; i < state.feasible.size(); i++) {
+            for (int fix = 0; fix < 3; fix++) indexes.push_back(state.kempeIndexes.empty() ? 0 : state.kempeIndexes[i][fix]);
+        }
+        std::filesystem::create_directories(std::filesystem::path(fileName).parent_path());
+        auto temporary = fileName + ".tmp";
+        {
+            std::ofstream ofs(temporary, std::ios::binary);
+            if (!ofs) {
+                spdlog::critical("Error: Failed to open {}", temporary);
+                throw std::runtime_error("Error opening " + temporary);
+            }
+            ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            ofs.write(reinterpret_cast<const char*>(words.data()), sizeof(uint64_t) * words.size());
+            ofs.write(reinterpret_cast<const char*>(indexes.data()), sizeof(int32_t) * indexes.size());
+            if (state.firstSuccess) {
+                vector<int32_t> edges(state.firstSuccess->begin(), state.firstSuccess->end());
+                ofs.write(reinterpret_cast<const char*>(edges.data()), sizeof(int32_t) * edges.size());
+            }
+            if (!ofs) {
+                spdlog::critical("Error: Failed to write {}", temporary);
+                throw std::runtime_error("Error writing " + temporary);
+            }
+        }
+        std::filesystem::rename(temporary, fileName);
+        lastWrite = std::chrono::steady_clock::now();
+        spdlog::debug("Wrote the checkpoint to {}", fileName);
+    }
+    // checkpoint を読み込む (ファイルがなければ std::nullopt、条件が一致しなければ例外を投げる)
+    optional<CheckpointState> Load() const {
+        if (!std::filesystem::exists(fileName)) return std::nullopt;
+        MappedFile file(fileName);
+        auto invalid = [&](const string& what) {
+            spdlog::critical("Error: Cannot resume from {}: {}", fileName, what);
+            throw std::runtime_error("Invalid checkpoint " + fileName);
+        };
+        CheckpointHeader header;
+        if (file.size() < sizeof(header)) invalid("truncated header");
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, checkpointMagic, sizeof(checkpointMagic)) != 0) invalid("not a checkpoint");
+        if (header.version != checkpointVersion) invalid(fmt::format("version {} is not supported", header.version));
+        auto& f = header.feasible;
+        auto& e = expected.feasible;
+        if (f.left != e.left || f.right != e.right || f.kempeType != e.kempeType) invalid("different ring size or Kempe type");
+        if (f.confHash != e.confHash) invalid("different configuration");
+        if (f.coloringHash != e.coloringHash) invalid("different coloring table (color/)");
+        if (header.minCont != expected.minCont || header.maxCont != expected.maxCont || header.haltType != expected.haltType || header.flags != expected.flags) {
+            invalid("different options (--cmin, -m, -h, -p or --symmetry)");
+        }
+        if (header.stage != checkpointD && header.stage != checkpointC) invalid("unknown stage");
+        size_t colorNum = f.colorNum;
+        size_t wordNum = (colorNum + 63) / 64;
+        size_t successSize = header.successSize < 0 ? 0 : header.successSize;
+        if (file.size() < sizeof(header) + sizeof(uint64_t) * wordNum + sizeof(int32_t) * (3 * colorNum + successSize)) invalid("truncated");
+        auto words = reinterpret_cast<const uint64_t*>(file.data() + sizeof(header));
+        auto indexes = reinterpret_cast<const int32_t*>(file.data() + sizeof(header) + sizeof(uint64_t) * wordNum);
+        CheckpointState state;
+        state.stage = header.stage;
+        state.feasible.resize(colorNum);
+        state.kempeIndexes.resize(colorNum);
+        for (size_t i = 0; i < colorNum; i++) {
+            state.feasible[i] = (words[i / 64] >> (i % 64)) & 1;
+            state.kempeIndexes[i] = {indexes[i * 3], indexes[i * 3 + 1], indexes[i * 3 + 2]};
+        }
+        state.iteration = header.iteration;
+        state.sweepPosition = header.sweepPosition;
+        state.sweepUpdateCount = header.sweepUpdateCount;
+        state.contPosition = header.contPosition;
+        state.contCount = header.contCount;
+        state.maxContSize = header.maxContSize;
+        state.lastContSize = header.lastContSize;
+        if (header.successSize >= 0) {
+            auto edges = indexes + 3 * colorNum;
+            state.firstSuccess = vector<int>(edges, edges + successSize);
+        }
+        return state;
+    }
+};
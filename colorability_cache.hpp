@@ -0,0 +1,174 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <optional>
+#include <mutex>
+#include <filesystem>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <spdlog/spdlog.h>
+#include <fmt/core.h>
+#include "coloring.hpp"
+#include "cubic_conf.hpp"
+#include "generate_colors.hpp"
+
+using std::string;
+using std::vector;
+using std::optional;
+
+// contraction ごとの CheckColorability の結果をファイルに保存しておくキャッシュ
+// 結果は configuration と contraction だけで決まり、Kempe chain の種類には依存しないので、種類を変えて実行し直すときに使い回せる
+// ファイル <cacheDir>/<configuration のハッシュ値>.bin は、ヘッダのあとに (縮約する辺の bitmask, 拡張可能な Coloring の bitset) の組を追記していく
+// 読み込みと追記は flock で排他し、書き込み途中で終了した末尾のレコードは読み込むときに切り詰める (以降のレコードがずれないように)
+class ColorabilityCache {
+    static constexpr char magic[8] = {'C', 'O', 'L', 'C', 'A', 'C', 'H', '1'};
+    struct Header {
+        char magic[8];
+        uint64_t confHash;
+        uint64_t coloringHash;
+        int32_t edgeSize;
+        int32_t colorNum;
+    };
+    string fileName;
+    int edgeSize;
+    int colorNum;
+    size_t maskBytes;
+    size_t bitsetBytes;
+    int fd = -1;
+    std::unordered_map<string, vector<bool>> entries; // key: 縮約する辺の bitmask
+    int hitCount = 0;
+    int missCount = 0;
+    std::mutex mtx;
+
+    string MaskOf(const vector<int>& contractEdges) const {
+        string mask(maskBytes, '\0');
+        for (auto e : contractEdges) {
+            mask[e / 8] |= char(1 << (e % 8));
+        }
+        return mask;
+    }
+    // fd のファイルを読み込む (ヘッダが一致しなければ作り直し、末尾の不完全なレコードは切り詰める)
+    void Load(const Header& expected) {
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            throw std::runtime_error("Error reading " + fileName);
+        }
+        size_t fileSize = st.st_size;
+        Header header;
+        if (fileSize > 0 && (fileSize < sizeof(header) || ::pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || std::memcmp(&header, &expected, sizeof(header)) != 0)) {
+            spdlog::warn("Colorability cache {} does not match this configuration, rebuilding it", fileName);
+            fileSize = 0;
+        }
+        if (fileSize == 0) {
+            if (::ftruncate(fd, 0) != 0 || ::pwrite(fd, &expected, sizeof(expected), 0) != (ssize_t)sizeof(expected)) {
+                throw std::runtime_error("Error writing " + fileName);
+            }
+            return;
+        }
+        size_t recordBytes = maskBytes + bitsetBytes;
+        size_t recordNum = (fileSize - sizeof(header)) / recordBytes;
+        size_t validSize = sizeof(header) + recordNum * recordBytes;
+        if (validSize != fileSize) {
+            spdlog::warn("Colorability cache {} ends with a torn record, truncating it", fileName);
+            if (::ftruncate(fd, validSize) != 0) {
+                throw std::runtime_error("Error writing " + fileName);
+            }
+        }
+        string record(recordBytes, '\0');
+        for (size_t r = 0; r < recordNum; r++) {
+            if (::pread(fd, record.data(), recordBytes, sizeof(header) + r * recordBytes) != (ssize_t)recordBytes) {
+                throw std::runtime_error("Error reading " + fileName);
+            }
+            vector<bool> contFeasible(colorNum);
+            for (int i = 0; i < colorNum; i++) {
+                contFeasible[i] = (record[maskBytes + i / 8] >> (i % 8)) & 1;
+            }
+            entries[record.substr(0, maskBytes)] = std::move(contFeasible);
+        }
+    }
+public:
+    ColorabilityCache(const string& cacheDir, const CubicConf& conf, const ColoringTable& colorings)
+        : edgeSize(conf.edge_size), colorNum(colorings.size()), maskBytes((conf.edge_size + 7) / 8), bitsetBytes((colorings.size() + 7) / 8) {
+        std::filesystem::create_directories(cacheDir);
+        fileName = cacheDir + "/" + fmt::format("{:016x}", conf.Hash()) + ".bin";
+        Header header = {};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.confHash = conf.Hash();
+        header.coloringHash = HashColorings(colorings);
+        header.edgeSize = edgeSize;
+        header.colorNum = colorNum;
+        fd = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) {
+            spdlog::critical("Error: Failed to open {}", fileName);
+            throw std::runtime_error("Error opening " + fileName);
+        }
+        ::flock(fd, LOCK_EX);
+        try {
+            Load(header);
+        }
+        catch (...) {
+            ::flock(fd, LOCK_UN);
+            ::close(fd);
+            fd = -1;
+            spdlog::critical("Error: Failed to load {}", fileName);
+            throw;
+        }
+        ::flock(fd, LOCK_UN);
+        spdlog::debug("Loaded {} cached contractions from {}", entries.size(), fileName);
+    }
+    ~ColorabilityCache() {
+        spdlog::debug("Colorability cache: {} hits, {} misses", hitCount, missCount);
+        if (fd >= 0) ::close(fd);
+    }
+    ColorabilityCache(const ColorabilityCache&) = delete;
+    ColorabilityCache& operator=(const ColorabilityCache&) = delete;
+
+    optional<vector<bool>> Find(const vector<int>& contractEdges) {
+        std::lock_guard lock(mtx);
+        auto it = entries.find(MaskOf(contractEdges));
+        if (it == entries.end()) {
+            missCount++;
+            return std::nullopt;
+        }
+        hitCount++;
+        return it->second;
+    }
+    void Store(const vector<int>& contractEdges, const vector<bool>& contFeasible) {
+        assert((int)contFeasible.size() == colorNum);
+        auto mask = MaskOf(contractEdges);
+        string record = mask + string(bitsetBytes, '\0');
+        for (int i = 0; i < colorNum; i++) {
+            if (contFeasible[i]) record[maskBytes + i / 8] |= char(1 << (i % 8));
+        }
+        std::lock_guard lock(mtx);
+        if (!entries.emplace(mask, contFeasible).second) return;
+        // レコード 1 つを 1 回の write で追記する (O_APPEND と flock で他のプロセスの追記・切り詰めと混ざらない)
+        ::flock(fd, LOCK_EX);
+        auto end = ::lseek(fd, 0, SEEK_END);
+        if (::write(fd, record.data(), record.size()) != (ssize_t)record.size()) {
+            spdlog::warn("Failed to append to colorability cache {}", fileName);
+            // 途中まで書けたレコードは取り除く
+            if (end >= 0 && ::ftruncate(fd, end) != 0) spdlog::warn("Failed to truncate colorability cache {}", fileName);
+        }
+        ::flock(fd, LOCK_UN);
+    }
+};
+
+// cache があればそれを参照し、なければ計算して cache に保存する CheckColorability
+vector<bool> CheckColorabilityCached(const CubicConf& conf, const ColoringTable& colorings, const vector<int>& contractEdges, ColorabilityCache* cache) {
+    if (cache) {
+        if (auto cached = cache->Find(contractEdges)) {
+            return *cached;
+        }
+    }
+    auto contFeasible = conf.CheckColorability(colorings, contractEdges);
+    if (cache) {
+        cache->Store(contractEdges, contFeasible);
+    }
+    return contFeasible;
+}
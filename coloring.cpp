@@ -3,24 +3,6 @@
 using std::cerr;
 using std::endl;
 
-vector<string> Coloring::FourDFS(const vector<string> &fours, int n) {
-    if ((int)fours[0].size() >= n) {
-        return fours;
-    }
-    vector<string> mores;
-    for (auto& four : fours) {
-        for (char c = '1'; c <= '4'; c++) {
-            if (c != four.back()) {
-                if (n == (int)four.size() + 1 && c == four[0]) {
-                    continue;
-                }
-                mores.push_back(four + c);
-            }
-        }
-    }
-    return FourDFS(mores, n);
-}
-
 vector<Coloring> Coloring::GetEquivalents() const {
     string other = str;
     for (auto& c : other) {
@@ -32,44 +14,37 @@ vector<Coloring> Coloring::GetEquivalents() const {
     return {*this, Coloring(other)};
 }
 
-unordered_set<Coloring> Coloring::GetValidColorings(int n) {
+void Coloring::ForEachValidColoring(int n, const std::function<void(const string&)>& visit) {
     assert(n >= 1);
     if (n == 1) {
-        return {Coloring("1")};
-    }
-    if (n == 2) {
-        return {Coloring("11")};
+        visit("1");
+        return;
     }
-    if (n == 3) {
-        return {Coloring("123")};
-    }
-    auto fours = FourDFS({"121", "123"}, n); // 4 頂点彩色を得る
-    unordered_set<Coloring> res;
-    for (auto& four : fours) {
-        assert((int)four.size() == n);
-        string three;
-        for (int i = 0; i < n; i++) {
-            int x = four[i] - '1';
-            int y = four[(i + 1) % n] - '1';
-            three += '0' + (x ^ y);
+    string str(n, '1');
+    // str[0..pos) が決まっていて、その XOR が parity, 1 以外の色が既に現れたかが seenOther
+    auto dfs = [&](auto&& self, int pos, int parity, bool seenOther) -> void {
+        if (pos == n - 1) {
+            // 最後の色は全体の XOR が 0 になるように決まる
+            if (parity == 0 || (!seenOther && parity == 3)) return;
+            str[pos] = '0' + parity;
+            visit(str);
+            return;
         }
-        // 辞書順最小となるように色を交換
-        char flags[3] = {};
-        char a = '1';
-        for (auto& c : three) {
-            assert('1' <= c && c <= '3');
-            if (flags[c - '1']) {}
-            else {
-                flags[c - '1'] = a++;
-            }
-            c = flags[c - '1'];
+        for (int c = 1; c <= (seenOther ? 3 : 2); c++) {
+            str[pos] = '0' + c;
+            self(self, pos + 1, parity ^ c, seenOther || c != 1);
         }
-        res.insert(Coloring(three));
-    }
+    };
+    dfs(dfs, 1, 1, false);
+}
+
+vector<Coloring> Coloring::GetValidColorings(int n) {
+    vector<Coloring> res;
+    ForEachValidColoring(n, [&](const string& str) { res.push_back(Coloring(str)); });
     return res;
 }
 
-vector<Coloring> Coloring::GetKempeChanges(const string& kempe, int fix) const {
+vector<Coloring> Coloring::GetKempeChanges(std::string_view kempe, int fix) const {
     vector<Coloring> res;
     for (unsigned long long bits = 0ull; bits < (1ull << (kempe.size() / 2 - 1)); bits++) {
         string newStr = str;
@@ -3,7 +3,9 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <functional>
 #include <cassert>
 
 using std::vector;
@@ -14,7 +16,6 @@ using std::pair;
 
 class Coloring {
     string str;
-    static vector<string> FourDFS(const vector<string> &fours, int n);
     void lexicalMin() {
         for (char &c : str){
             if (c == '2') return;
@@ -64,10 +65,21 @@ public:
     }
     // 123 -> {123,132} を返す
     vector<Coloring> GetEquivalents() const;
-    // 大きさ n のリングの (parity が valid な) 3 彩色を得る
-    static unordered_set<Coloring> GetValidColorings(int n);
+    // 大きさ n のリングの (parity が valid な) 3 彩色を、辞書順最小な代表元の辞書順に 1 つずつ visit に渡す
+    // 色 1, 2, 3 を 01, 10, 11 とみなしたときに全体の XOR が 0 となる列のうち、先頭が 1 で、最初に現れる 1 以外の色が 2 であるものを列挙する
+    static void ForEachValidColoring(int n, const std::function<void(const string&)>& visit);
+    // 大きさ n のリングの (parity が valid な) 3 彩色を辞書順に得る
+    static vector<Coloring> GetValidColorings(int n);
     // 色 fix を固定し、それ以外の 2 色を kempe によって change した結果得られる全ての Coloring を返す
-    vector<Coloring> GetKempeChanges(const string& kempe, int fix) const;
+    vector<Coloring> GetKempeChanges(std::string_view kempe, int fix) const;
+    // リング上の辺 r の色を perm[r] に移した Coloring (辞書順最小に直したもの) を返す
+    Coloring Permuted(const vector<int>& perm) const {
+        string res(str.size(), '0');
+        for (int r = 0; r < (int)str.size(); r++) {
+            res[perm[r]] = str[r];
+        }
+        return GetLexicalMin(res);
+    }
     // 辞書順最小とは限らない string を受け取り、辞書順最小の Coloring を返す
     static Coloring GetLexicalMin(const string& str) {
         unordered_map<char, char> m;
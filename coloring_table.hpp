@@ -0,0 +1,83 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+#include "coloring.hpp"
+
+using std::string;
+using std::vector;
+
+// リングの Coloring の列 (ファイルの並び順) を、1 つの Coloring につき 1 行の固定長の文字列として連続した領域に並べたもの
+// Coloring から番号を引くための索引 order (行を辞書順に並べたときの番号の列) も連続した領域に持ち、二分探索で引く
+// どちらの領域も位置に依存しないので、共有メモリのセグメントに置いたものをそのまま使える (owner が保持している)
+class ColoringTable {
+    std::shared_ptr<const void> owner;
+    const char* rows = nullptr;
+    const int32_t* order = nullptr;
+    size_t count = 0;
+    int width = 0;
+public:
+    ColoringTable() = default;
+    ColoringTable(std::shared_ptr<const void> owner, const char* rows, const int32_t* order, size_t count, int width)
+        : owner(std::move(owner)), rows(rows), order(order), count(count), width(width) {}
+    // rows の行を辞書順に並べたときの番号の列
+    static vector<int32_t> SortedOrder(const char* rows, size_t count, int width) {
+        vector<int32_t> res(count);
+        for (size_t i = 0; i < count; i++) res[i] = i;
+        std::sort(res.begin(), res.end(), [&](int32_t a, int32_t b) {
+            return std::string_view(rows + size_t(a) * width, width) < std::string_view(rows + size_t(b) * width, width);
+        });
+        return res;
+    }
+    // rowsOwner が保持する行の列に、このプロセスで作った索引を付ける
+    static ColoringTable WithOrder(std::shared_ptr<const void> rowsOwner, const char* rows, size_t count, int width) {
+        struct Owner {
+            std::shared_ptr<const void> rows;
+            vector<int32_t> order;
+        };
+        auto owner = std::make_shared<Owner>(Owner{std::move(rowsOwner), SortedOrder(rows, count, width)});
+        return ColoringTable(owner, rows, owner->order.data(), count, width);
+    }
+    static ColoringTable FromColorings(const vector<Coloring>& colorings) {
+        int width = colorings.empty() ? 0 : colorings[0].size();
+        auto buffer = std::make_shared<string>();
+        buffer->reserve(colorings.size() * width);
+        for (auto& coloring : colorings) {
+            assert((int)coloring.size() == width);
+            *buffer += coloring.StringOf();
+        }
+        return WithOrder(buffer, buffer->data(), colorings.size(), width);
+    }
+    size_t size() const {
+        return count;
+    }
+    int Width() const {
+        return width;
+    }
+    std::string_view operator[](size_t i) const {
+        return std::string_view(rows + i * width, width);
+    }
+    Coloring At(size_t i) const {
+        return Coloring(string((*this)[i]));
+    }
+    // 辞書順で k 番目の行の番号
+    int32_t OrderAt(size_t k) const {
+        return order[k];
+    }
+    // coloring の番号 (含まれていなければ -1)
+    int IndexOf(std::string_view coloring) const {
+        size_t lo = 0, hi = count;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            int c = (*this)[order[mid]].compare(coloring);
+            if (c == 0) return order[mid];
+            if (c < 0) lo = mid + 1;
+            else hi = mid;
+        }
+        return -1;
+    }
+};
@@ -0,0 +1,180 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <filesystem>
+#include <utility>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+#include "cubic_conf.hpp"
+#include "mapped_file.hpp"
+#include "duality.hpp"
+
+using std::string;
+using std::vector;
+
+// 多数の configuration を 1 つにまとめたバイナリファイル (.bundle) の形式
+// ヘッダ、索引 (configuration ごとの ConfBundleEntry)、各頂点に接する 3 本の辺を int32 で並べた配列、名前、の順に並ぶ
+// mmap してそのまま読めるので、テキストのファイルを 1 つずつ開いて読むより速い
+// 非 annular の場合 (left, right) = (リングの大きさ, 0)、annular の場合 (left, right) = (左右のリングの大きさ)
+struct ConfBundleHeader {
+    char magic[8];
+    uint32_t annular;
+    uint32_t entryNum;
+};
+struct ConfBundleEntry {
+    int32_t vertexSize;
+    int32_t left;
+    int32_t right;
+    uint32_t nameLength;
+    uint64_t nameOffset; // ファイル先頭からの位置
+    uint64_t offset; // 辺の配列 (int32 が vertexSize * 3 個) のファイル先頭からの位置
+};
+constexpr char confBundleMagic[8] = {'C', 'O', 'N', 'F', 'B', 'N', '0', '1'};
+
+// 名前と辺の配列を並べた configuration の一覧を bundle として出力する
+void WriteConfBundleEntries(const string& fileName, vector<ConfBundleEntry> entries, const vector<string>& names, const vector<vector<int32_t>>& edges, bool isAnnular) {
+    uint64_t offset = sizeof(ConfBundleHeader) + sizeof(ConfBundleEntry) * entries.size();
+    for (size_t i = 0; i < entries.size(); i++) {
+        entries[i].offset = offset;
+        offset += sizeof(int32_t) * edges[i].size();
+    }
+    for (size_t i = 0; i < entries.size(); i++) {
+        entries[i].nameOffset = offset;
+        entries[i].nameLength = names[i].size();
+        offset += names[i].size();
+    }
+
+    std::ofstream ofs(fileName, std::ios::binary);
+    if (!ofs) {
+        spdlog::critical("Error: Failed to open {}", fileName);
+        throw std::runtime_error("Error opening " + fileName);
+    }
+    spdlog::info("Writing {} configurations to {}", entries.size(), fileName);
+    ConfBundleHeader header = {};
+    std::memcpy(header.magic, confBundleMagic, sizeof(header.magic));
+    header.annular = isAnnular;
+    header.entryNum = entries.size();
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(entries.data()), sizeof(ConfBundleEntry) * entries.size());
+    for (auto& vertexEdges : edges) {
+        ofs.write(reinterpret_cast<const char*>(vertexEdges.data()), sizeof(int32_t) * vertexEdges.size());
+    }
+    for (auto& name : names) {
+        ofs.write(name.data(), name.size());
+    }
+}
+
+// configuration のファイル (.dconf または .nconf) をまとめて bundle として出力する
+// 名前は各ファイルの拡張子を除いたファイル名
+void WriteConfBundle(const string& fileName, const vector<string>& files, bool isAnnular) {
+    vector<ConfBundleEntry> entries;
+    vector<string> names;
+    vector<vector<int32_t>> edges;
+    for (auto& confFile : files) {
+        std::ifstream ifs(confFile);
+        ConfBundleEntry entry = {};
+        ifs >> entry.vertexSize >> entry.left;
+        if (isAnnular) ifs >> entry.right;
+        if (!ifs || entry.vertexSize <= 0 || entry.left <= 0 || (isAnnular && entry.right <= 0)) {
+            spdlog::critical("Error: Invalid configuration header in {}", confFile);
+            throw std::runtime_error("Invalid configuration header in " + confFile);
+        }
+        vector<int32_t> vertexEdges(entry.vertexSize * 3);
+        for (auto& e : vertexEdges) {
+            if (!(ifs >> e)) {
+                spdlog::critical("Error: Missing edges in {}", confFile);
+                throw std::runtime_error("Invalid configuration edge in " + confFile);
+            }
+        }
+        entries.push_back(entry);
+        names.push_back(std::filesystem::path(confFile).stem().string());
+        edges.push_back(std::move(vertexEdges));
+    }
+    WriteConfBundleEntries(fileName, std::move(entries), names, edges, isAnnular);
+}
+
+// sources (.conf ファイル、"-" なら標準入力) の .conf を双対の configuration に変換して bundle として出力する
+// 名前は ForEachPrimalConf と同じ
+void WriteConfBundleOfConfs(const string& fileName, const vector<string>& sources) {
+    vector<ConfBundleEntry> entries;
+    vector<string> names;
+    vector<vector<int32_t>> edges;
+    ForEachPrimalConf(sources, [&](const string& name, const PrimalConf& primal) {
+        auto vertexEdges = DualVertexEdges(primal);
+        ConfBundleEntry entry = {};
+        entry.vertexSize = vertexEdges.size() / 3;
+        entry.left = primal.R;
+        entries.push_back(entry);
+        names.push_back(name);
+        edges.push_back(std::move(vertexEdges));
+    });
+    WriteConfBundleEntries(fileName, std::move(entries), names, edges, false);
+}
+
+// bundle を mmap し、i 番目の configuration を (テキストを解析せずに) 作る
+class ConfBundle {
+    std::shared_ptr<MappedFile> file;
+    ConfBundleHeader header;
+    const ConfBundleEntry& Entry(size_t i) const {
+        return reinterpret_cast<const ConfBundleEntry*>(file->data() + sizeof(ConfBundleHeader))[i];
+    }
+public:
+    explicit ConfBundle(const string& fileName) : file(std::make_shared<MappedFile>(fileName)) {
+        bool valid = file->size() >= sizeof(header);
+        if (valid) {
+            std::memcpy(&header, file->data(), sizeof(header));
+            valid = std::memcmp(header.magic, confBundleMagic, sizeof(header.magic)) == 0
+                && file->size() >= sizeof(header) + sizeof(ConfBundleEntry) * header.entryNum;
+        }
+        for (size_t i = 0; valid && i < size(); i++) {
+            auto& entry = Entry(i);
+            valid = entry.vertexSize > 0 && entry.offset % sizeof(int32_t) == 0
+                && entry.offset + sizeof(int32_t) * 3 * entry.vertexSize <= file->size()
+                && entry.nameOffset + entry.nameLength <= file->size();
+        }
+        if (!valid) {
+            spdlog::critical("Error: {} is not a valid configuration bundle", fileName);
+            throw std::runtime_error("Invalid configuration bundle " + fileName);
+        }
+    }
+    size_t size() const {
+        return header.entryNum;
+    }
+    bool IsAnnular() const {
+        return header.annular != 0;
+    }
+    string Name(size_t i) const {
+        auto& entry = Entry(i);
+        return string(file->data() + entry.nameOffset, entry.nameLength);
+    }
+    // (リングの大きさ, 頂点数)
+    std::pair<int, int> SizeOf(size_t i) const {
+        auto& entry = Entry(i);
+        return {entry.left + entry.right, entry.vertexSize};
+    }
+    template <typename Conf>
+    Conf Load(size_t i) const {
+        auto& entry = Entry(i);
+        auto edges = reinterpret_cast<const int32_t*>(file->data() + entry.offset);
+        if constexpr (std::same_as<Conf, AnnularCubicConf>) {
+            if (!IsAnnular()) {
+                spdlog::critical("Error: The bundle does not contain annular configurations");
+                throw std::runtime_error("Not an annular configuration bundle");
+            }
+            return AnnularCubicConf::fromVertexEdges(entry.vertexSize, entry.left, entry.right, edges);
+        }
+        else {
+            if (IsAnnular()) {
+                spdlog::critical("Error: The bundle contains annular configurations (use -n)");
+                throw std::runtime_error("Annular configuration bundle");
+            }
+            return CubicConf::fromVertexEdges(entry.vertexSize, entry.left, edges);
+        }
+    }
+};
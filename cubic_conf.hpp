@@ -6,7 +6,16 @@
 #include <string>
 #include <utility>
 #include <concepts>
+#include <algorithm>
+#include <stdexcept>
+#include <map>
+#include <tuple>
+#include <cstdint>
 #include <spdlog/spdlog.h>
+#include "hashing.hpp"
+#include "metrics.hpp"
+#include "budget.hpp"
+#include "coloring_table.hpp"
 using std::vector;
 using std::ifstream;
 using std::string;
@@ -30,8 +39,65 @@ public:
     const int ring_size; // リングを通過している辺の個数
 protected:
     vector<vector<pair<int, int>>> EtoEE; // 辺の両端について、ほかにその頂点とつながっている辺の番号のペア
+    vector<vector<int>> VtoE; // 各頂点について、隣接している辺 3 つ
+    vector<vector<int>> EtoV; // 各辺について、その辺の端点となっている頂点 (リング上の辺は 1 つ、内部の辺は 2 つ)
+    // perm (辺の置換、未定の辺は -1) を、頂点を頂点に移すように拡張できるか
+    // inv は perm の逆写像で、拡張できた場合は perm, inv に結果が入る
+    bool extendAutomorphism(vector<int> &perm, vector<int> &inv) const {
+        auto vertexOf = [&](int a, int b, int c) {
+            for (auto v : EtoV[a]) {
+                auto& es = VtoE[v];
+                if (std::count(es.begin(), es.end(), b) && std::count(es.begin(), es.end(), c)) return v;
+            }
+            return -1;
+        };
+        for (int v = 0; v < (int)VtoE.size(); v++) {
+            auto& es = VtoE[v];
+            int knownCount = 0;
+            for (auto e : es) knownCount += perm[e] >= 0 ? 1 : 0;
+            if (knownCount == 0) continue;
+            if (knownCount == 3) {
+                if (vertexOf(perm[es[0]], perm[es[1]], perm[es[2]]) < 0) return false;
+                continue;
+            }
+            // 辺の対応が一部だけ決まっている頂点について、残りの辺の対応を全通り試す
+            int known = perm[es[0]] >= 0 ? es[0] : perm[es[1]] >= 0 ? es[1] : es[2];
+            for (auto w : EtoV[perm[known]]) {
+                vector<int> targets = VtoE[w];
+                std::sort(targets.begin(), targets.end());
+                do {
+                    bool consistent = true;
+                    for (int j = 0; j < 3; j++) {
+                        if (perm[es[j]] >= 0 ? perm[es[j]] != targets[j] : inv[targets[j]] >= 0) {
+                            consistent = false;
+                            break;
+                        }
+                    }
+                    if (!consistent) continue;
+                    vector<int> assigned;
+                    for (int j = 0; j < 3; j++) {
+                        if (perm[es[j]] < 0) {
+                            perm[es[j]] = targets[j];
+                            inv[targets[j]] = es[j];
+                            assigned.push_back(es[j]);
+                        }
+                    }
+                    if (extendAutomorphism(perm, inv)) return true;
+                    for (auto e : assigned) {
+                        inv[perm[e]] = -1;
+                        perm[e] = -1;
+                    }
+                } while (std::next_permutation(targets.begin(), targets.end()));
+            }
+            return false;
+        }
+        // すべての辺の対応が決まっている (リングから辿れない部分はない)
+        return std::find(perm.begin(), perm.end(), -1) == perm.end();
+    }
     // [0,e) の辺が色付けされているとき、残りの辺を 3 彩色可能か
     bool color_dfs(int e, vector<int> &color_tmp, const vector<bool> &exists) const {
+        Metrics::Add(DfsNodes);
+        Budget::Poll();
         if (e == edge_size) {
             return true;
         }
@@ -89,8 +155,14 @@ public:
     // ring_size: リングを通過している辺の個数 (0..ring_size が リング上、ring_size.. が内部の辺に対応)
     // VtoE：各頂点について、隣接している辺 3 つからなる vector の vector
     // 例: {{0,7,17},{1,8,18},{2,9,10},...}
-    CubicConf(int edge_size, int ring_size, vector<vector<int>> VtoE): edge_size(edge_size), ring_size(ring_size) {
+    CubicConf(int edge_size, int ring_size, vector<vector<int>> VtoE): edge_size(edge_size), ring_size(ring_size), VtoE(VtoE) {
         EtoEE.resize(edge_size);
+        EtoV.resize(edge_size);
+        for (int v = 0; v < (int)VtoE.size(); v++) {
+            for (auto e : VtoE[v]) {
+                EtoV[e].push_back(v);
+            }
+        }
         for(auto& es : VtoE) {
             assert(es.size() == 3);
             const auto e1 = es[0];
@@ -101,24 +173,215 @@ public:
             EtoEE[e3].emplace_back(e1, e2);
         }
     }
-    // ifstream から入力を受け取り、CubicConf を返す
-    static CubicConf fromFile(ifstream& ifs) {
-        int vertexSize, ringSize;
+    // 入力ストリームから configuration を受け取り、CubicConf を返す (形式が正しくなければ例外を投げる)
+    static CubicConf fromFile(std::istream& ifs) {
+        int vertexSize = 0, ringSize = 0;
         ifs >> vertexSize >> ringSize;
-        assert(vertexSize > 0 && ringSize > 0);
+        if (!ifs || vertexSize <= 0 || ringSize <= 0) {
+            spdlog::critical("Error: Invalid configuration header");
+            throw std::runtime_error("Invalid configuration header");
+        }
+        vector<int32_t> edges(vertexSize * 3, -1);
+        for (auto& e : edges) {
+            if (!(ifs >> e)) e = -1;
+        }
+        return fromVertexEdges(vertexSize, ringSize, edges.data());
+    }
+    // 頂点 i に接する辺を edges[3i], edges[3i+1], edges[3i+2] に並べた配列から作る (ファイルを mmap したものなど)
+    static CubicConf fromVertexEdges(int vertexSize, int ringSize, const int32_t* edges) {
         int edgeSize = (vertexSize * 3 - ringSize) / 2 + ringSize;
         vector<vector<int>> VtoE(vertexSize);
         for (int i = 0; i < vertexSize; i++) {
             for (int j = 0; j < 3; j++) {
-                int e;
-                ifs >> e;
-                assert(0 <= e && e < edgeSize);
+                int e = edges[i * 3 + j];
+                if (e < 0 || e >= edgeSize) {
+                    spdlog::critical("Error: Invalid edge of vertex {}", i);
+                    throw std::runtime_error("Invalid configuration edge");
+                }
                 VtoE[i].push_back(e);
             }
         }
         spdlog::info("Vertex size: {}, Edge size: {}, Ring size: {}", vertexSize, edgeSize, ringSize);
         return CubicConf(edgeSize, ringSize, VtoE);
     }
+    // 辺の接続関係から計算したハッシュ値 (同じファイルから読み込んだ configuration なら同じ値になる)
+    uint64_t Hash() const {
+        Fnv1a hash;
+        hash.Add(edge_size);
+        hash.Add(ring_size);
+        for (auto& ees : EtoEE) {
+            hash.Add((int)ees.size());
+            for (auto [f, g] : ees) {
+                hash.Add(f);
+                hash.Add(g);
+            }
+        }
+        return hash.Value();
+    }
+    // 辺の番号の付け方によらない標準形 (リング上の辺の巡回順序は保つ)
+    struct CanonicalForm {
+        uint64_t hash;
+        vector<int> edgeLabel; // 辺 e の標準形での番号 (リング上の辺は 0..ring_size、内部の辺は ring_size..)
+    };
+    // リングの回転 (useRotations)・反転 (useReflections) で移り合うものを同一視した標準形を求める
+    // 各回転・反転について、リングからの位置で頂点を色分けして (color refinement)、リングに接する頂点から幅優先で頂点を並べ、
+    // 同じ色の頂点の順序は全通り試して、頂点ごとの隣接関係を並べた列が辞書順最小となるものを標準形とする
+    CanonicalForm Canonicalize(bool useRotations, bool useReflections) const {
+        const int n = ring_size;
+        const int vertexSize = VtoE.size();
+        auto otherEnd = [&](int e, int v) {
+            return EtoV[e][0] == v ? EtoV[e].back() : EtoV[e][0];
+        };
+        vector<int> bestCode, bestPosition, bestRingPos;
+        vector<int> ringPos(n), color(vertexSize);
+        vector<int> order, position(vertexSize);
+        // 頂点の並び order (position はその逆写像) に対する、頂点ごとの隣接関係の列
+        auto evaluate = [&] {
+            vector<int> code;
+            code.reserve(vertexSize * 3);
+            for (int v : order) {
+                int tokens[3];
+                for (int j = 0; j < 3; j++) {
+                    int e = VtoE[v][j];
+                    tokens[j] = e < n ? ringPos[e] : n + position[otherEnd(e, v)];
+                }
+                std::sort(tokens, tokens + 3);
+                code.insert(code.end(), tokens, tokens + 3);
+            }
+            if (bestCode.empty() || code < bestCode) {
+                bestCode = std::move(code);
+                bestPosition = position;
+                bestRingPos = ringPos;
+            }
+        };
+        auto place = [&](int v) {
+            position[v] = order.size();
+            order.push_back(v);
+        };
+        auto unplace = [&] {
+            position[order.back()] = -1;
+            order.pop_back();
+        };
+        auto search = [&](auto&& self, int head) -> void {
+            if (head == (int)order.size()) {
+                if ((int)order.size() == vertexSize) {
+                    evaluate();
+                    return;
+                }
+                // リングから辿れない頂点が残っている場合は、色が最小のものから続ける
+                int minColor = vertexSize;
+                for (int v = 0; v < vertexSize; v++) {
+                    if (position[v] < 0) minColor = std::min(minColor, color[v]);
+                }
+                for (int v = 0; v < vertexSize; v++) {
+                    if (position[v] >= 0 || color[v] != minColor) continue;
+                    place(v);
+                    self(self, head);
+                    unplace();
+                }
+                return;
+            }
+            int v = order[head];
+            vector<int> next;
+            for (int e : VtoE[v]) {
+                if (e < n) continue;
+                int u = otherEnd(e, v);
+                if (position[u] < 0 && std::find(next.begin(), next.end(), u) == next.end()) next.push_back(u);
+            }
+            std::sort(next.begin(), next.end(), [&](int a, int b) { return std::make_pair(color[a], a) < std::make_pair(color[b], b); });
+            // 色の順序を保つ並べ方 (同じ色の頂点の順序) を全通り試す
+            do {
+                bool sorted = true;
+                for (int i = 0; i + 1 < (int)next.size(); i++) {
+                    if (color[next[i]] > color[next[i + 1]]) sorted = false;
+                }
+                if (!sorted) continue;
+                for (int u : next) place(u);
+                self(self, head + 1);
+                for (int i = 0; i < (int)next.size(); i++) unplace();
+            } while (std::next_permutation(next.begin(), next.end()));
+        };
+        for (int reflect = 0; reflect <= (useReflections ? 1 : 0); reflect++) {
+            for (int shift = 0; shift < (useRotations ? n : 1); shift++) {
+                for (int r = 0; r < n; r++) {
+                    ringPos[r] = reflect ? (shift - r + n) % n : (r - shift + n) % n;
+                }
+                // 色の値は頂点の番号によらず、隣接関係の列の大小だけで決める
+                vector<vector<int>> signature(vertexSize);
+                for (int v = 0; v < vertexSize; v++) {
+                    for (int e : VtoE[v]) signature[v].push_back(e < n ? ringPos[e] : n);
+                    std::sort(signature[v].begin(), signature[v].end());
+                }
+                int classCount = 0;
+                while (true) {
+                    std::map<vector<int>, int> ids;
+                    for (auto& sig : signature) ids[sig] = 0;
+                    int id = 0;
+                    for (auto& [sig, value] : ids) value = id++;
+                    for (int v = 0; v < vertexSize; v++) color[v] = ids[signature[v]];
+                    if ((int)ids.size() == classCount) break;
+                    classCount = ids.size();
+                    for (int v = 0; v < vertexSize; v++) {
+                        signature[v] = {color[v]};
+                        vector<int> neighbors;
+                        for (int e : VtoE[v]) neighbors.push_back(e < n ? -1 : color[otherEnd(e, v)]);
+                        std::sort(neighbors.begin(), neighbors.end());
+                        signature[v].insert(signature[v].end(), neighbors.begin(), neighbors.end());
+                    }
+                }
+                order.clear();
+                std::fill(position.begin(), position.end(), -1);
+                vector<int> ringEdgeAt(n);
+                for (int r = 0; r < n; r++) ringEdgeAt[ringPos[r]] = r;
+                for (int p = 0; p < n; p++) {
+                    int v = EtoV[ringEdgeAt[p]][0];
+                    if (position[v] < 0) place(v);
+                }
+                search(search, 0);
+            }
+        }
+        CanonicalForm res;
+        Fnv1a hash;
+        hash.Add(edge_size);
+        hash.Add(ring_size);
+        hash.Add(vertexSize);
+        hash.Add(bestCode.data(), bestCode.size() * sizeof(int));
+        res.hash = hash.Value();
+        res.edgeLabel.assign(edge_size, -1);
+        vector<std::tuple<int, int, int>> innerEdges;
+        for (int e = 0; e < edge_size; e++) {
+            if (e < n) {
+                res.edgeLabel[e] = bestRingPos[e];
+                continue;
+            }
+            int a = bestPosition[EtoV[e][0]], b = bestPosition[EtoV[e].back()];
+            innerEdges.emplace_back(std::min(a, b), std::max(a, b), e);
+        }
+        std::sort(innerEdges.begin(), innerEdges.end());
+        for (int i = 0; i < (int)innerEdges.size(); i++) {
+            res.edgeLabel[std::get<2>(innerEdges[i])] = n + i;
+        }
+        return res;
+    }
+    // リングを回転・反転させる置換 (リング上の辺 r を perm[r] に移す) のうち、グラフ全体の自己同型に拡張できるものを返す (恒等置換は除く)
+    vector<vector<int>> GetRingSymmetries() const {
+        vector<vector<int>> res;
+        for (int reflect = 0; reflect < 2; reflect++) {
+            for (int k = 0; k < ring_size; k++) {
+                if (!reflect && k == 0) continue;
+                vector<int> perm(edge_size, -1), inv(edge_size, -1);
+                for (int r = 0; r < ring_size; r++) {
+                    perm[r] = reflect ? (k - r + ring_size) % ring_size : (r + k) % ring_size;
+                    inv[perm[r]] = r;
+                }
+                if (extendAutomorphism(perm, inv)) {
+                    perm.resize(ring_size);
+                    res.push_back(perm);
+                }
+            }
+        }
+        return res;
+    }
     // colors: リング上の各辺に対して色 [1,2,3] のいずれかを割り当てるような彩色が可能か
     bool CanColorWith(Coloring colors, const vector<bool> &exists, bool isRingIndependent = true) const {
         assert(colors.size() == (unsigned)ring_size);
@@ -163,6 +426,37 @@ public:
         return true;
     }
 
+    // contractEdges が GetGoodContractions で列挙される縮約方法か (内部の辺だけからなり、縮約する辺がちょうど 2 本である頂点がない) を返す
+    bool IsGoodContraction(const vector<int>& contractEdges) const {
+        vector<bool> exists(edge_size, true);
+        for (auto e : contractEdges) {
+            if (e < ring_size || e >= edge_size || !exists[e]) return false;
+            exists[e] = false;
+        }
+        for (int e = 0; e < edge_size; e++) {
+            for (auto [f, g] : EtoEE[e]) {
+                if ((exists[e] ? 0 : 1) + (exists[f] ? 0 : 1) + (exists[g] ? 0 : 1) == 2) return false;
+            }
+        }
+        return !contractEdges.empty();
+    }
+
+    // 縮約する辺 (exists[e] == false) のうち、リング上の辺と頂点を共有しているものの個数を返す
+    int CountRingAdjacent(const vector<bool> &exists) const {
+        vector<bool> adjacent(edge_size, false);
+        for (int r = 0; r < ring_size; r++) {
+            for (auto [f, g] : EtoEE[r]) {
+                adjacent[f] = true;
+                adjacent[g] = true;
+            }
+        }
+        int res = 0;
+        for (int e = ring_size; e < edge_size; e++) {
+            if (!exists[e] && adjacent[e]) res++;
+        }
+        return res;
+    }
+
     // valid な縮約方法 (次数 1 が存在しないような縮約方法) を賢く列挙
     vector<vector<bool>> GetGoodContractions(int contSizeMin, int contSizeMax) const {
         vector<vector<bool>> existsList;
@@ -272,7 +566,7 @@ public:
     }
 
     // Coloring の情報を受け取り、各 Coloring に対して内部彩色が可能かを返す
-    vector<bool> CheckColorability(const vector<Coloring>& ringColorings, const vector<int>& contractEdges = vector<int>(), bool isRingIndependent = true) const {
+    vector<bool> CheckColorability(const ColoringTable& ringColorings, const vector<int>& contractEdges = vector<int>(), bool isRingIndependent = true) const {
         int feasibleCount = 0;
         vector<bool> exists(edge_size, true);
         for (auto contract : contractEdges) {
@@ -280,7 +574,8 @@ public:
             exists[contract] = false;
         }
         vector<bool> res;
-        for (auto& colors : ringColorings) {
+        for (size_t i = 0; i < ringColorings.size(); i++) {
+            auto colors = ringColorings.At(i);
             auto feasible = CanColorWith(colors, exists, isRingIndependent);
             res.push_back(feasible);
             if (feasible) {
@@ -312,18 +607,31 @@ public:
     pair<size_t, size_t> annularRing() const {
         return {left_ring_size, right_ring_size};
     }
-    static AnnularCubicConf fromFile(ifstream& ifs) {
-        int vertexSize, leftSize, rightSize;
+    static AnnularCubicConf fromFile(std::istream& ifs) {
+        int vertexSize = 0, leftSize = 0, rightSize = 0;
         ifs >> vertexSize >> leftSize >> rightSize;
-        assert(vertexSize > 0 && leftSize > 0 && rightSize > 0);
+        if (!ifs || vertexSize <= 0 || leftSize <= 0 || rightSize <= 0) {
+            spdlog::critical("Error: Invalid configuration header");
+            throw std::runtime_error("Invalid configuration header");
+        }
+        vector<int32_t> edges(vertexSize * 3, -1);
+        for (auto& e : edges) {
+            if (!(ifs >> e)) e = -1;
+        }
+        return fromVertexEdges(vertexSize, leftSize, rightSize, edges.data());
+    }
+    // 頂点 i に接する辺を edges[3i], edges[3i+1], edges[3i+2] に並べた配列から作る
+    static AnnularCubicConf fromVertexEdges(int vertexSize, int leftSize, int rightSize, const int32_t* edges) {
         int ringSize = leftSize + rightSize;
         int edgeSize = (vertexSize * 3 - ringSize) / 2 + ringSize;
         vector<vector<int>> VtoE(vertexSize);
         for (int i = 0; i < vertexSize; i++) {
             for (int j = 0; j < 3; j++) {
-                int e;
-                ifs >> e;
-                assert(0 <= e && e < edgeSize);
+                int e = edges[i * 3 + j];
+                if (e < 0 || e >= edgeSize) {
+                    spdlog::critical("Error: Invalid edge of vertex {}", i);
+                    throw std::runtime_error("Invalid configuration edge");
+                }
                 VtoE[i].push_back(e);
             }
         }
@@ -0,0 +1,256 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <sstream>
+#include <fstream>
+#include <optional>
+#include <string_view>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <filesystem>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/base_sink.h>
+#include <boost/program_options/parsers.hpp>
+#include "batch.hpp"
+
+using std::string;
+using std::vector;
+
+// デーモンへのリクエストの形式:
+//   1 行目: オプション (コマンドライン引数と同じもの、-i を除く) を空白区切りで並べたもの
+//   2 行目: configuration の名前 (-i のファイル名から拡張子を除いたもの。証明書・checkpoint のファイル名に使う)
+//   3 行目以降: configuration のファイルの中身
+// クライアントは送り終えたら書き込み側を閉じ、判定のログ (進捗と結果) が送られてきたあと、
+// 最後に daemonStatusPrefix に続けて終了コード (0: 成功, 1: エラー, overBudgetExitCode: 予算切れ) を書いた行が送られてくる
+constexpr size_t maxDaemonRequestSize = 1 << 24;
+constexpr std::string_view daemonStatusPrefix = "#status ";
+
+// fd (ソケット) にログを書き込む sink (相手が接続を閉じていても判定は続ける)
+class FdSink : public spdlog::sinks::base_sink<std::mutex> {
+    int fd;
+public:
+    explicit FdSink(int fd) : fd(fd) {}
+protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override {
+        spdlog::memory_buf_t formatted;
+        formatter_->format(msg, formatted);
+        const char* p = formatted.data();
+        size_t rest = formatted.size();
+        while (rest > 0) {
+            auto written = ::send(fd, p, rest, MSG_NOSIGNAL);
+            if (written <= 0) return;
+            p += written;
+            rest -= written;
+        }
+    }
+    void flush_() override {}
+};
+
+sockaddr_un SocketAddressOf(const string& socketPath) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        spdlog::critical("Error: Socket path {} is too long", socketPath);
+        throw std::runtime_error("Socket path too long");
+    }
+    std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+// 1 つの接続のリクエストを読み、判定してログと終了コードを返す
+void HandleDaemonRequest(int fd, const std::function<std::optional<EvaluateOptions>(const vector<string>&)>& parseOptions) {
+    string request;
+    char buffer[1 << 16];
+    while (request.size() <= maxDaemonRequestSize) {
+        auto n = ::read(fd, buffer, sizeof(buffer));
+        if (n <= 0) break;
+        request.append(buffer, n);
+    }
+    auto sink = std::make_shared<FdSink>(fd);
+    int status = 1;
+    {
+        RoutingSink::Scope scope(sink);
+        if (request.size() > maxDaemonRequestSize) {
+            spdlog::error("Request is too large");
+        }
+        else {
+            auto lineEnd = request.find('\n');
+            auto args = boost::program_options::split_unix(request.substr(0, lineEnd));
+            auto nameEnd = lineEnd == string::npos ? string::npos : request.find('\n', lineEnd + 1);
+            // ディレクトリの外にファイルを書かないように、名前はファイル名の部分だけを使う
+            auto confName = lineEnd == string::npos ? string() : std::filesystem::path(request.substr(lineEnd + 1, nameEnd - lineEnd - 1)).filename().string();
+            std::istringstream conf(nameEnd == string::npos ? string() : request.substr(nameEnd + 1));
+            try {
+                if (auto options = parseOptions(args)) {
+                    options->confName = confName;
+                    auto results = options->isAnnular ? EvaluateConf<AnnularCubicConf>(conf, *options) : EvaluateConf<CubicConf>(conf, *options);
+                    status = IsOverBudget(results) ? overBudgetExitCode : 0;
+                }
+            }
+            catch (const std::exception& e) {
+                spdlog::critical("The program threw an error: {}", e.what());
+            }
+        }
+    }
+    auto line = string(daemonStatusPrefix) + std::to_string(status) + "\n";
+    [[maybe_unused]] auto sent = ::send(fd, line.data(), line.size(), MSG_NOSIGNAL);
+}
+
+// Unix ドメインソケット socketPath でリクエストを待ち受け、workerNum 個のワーカースレッドで判定する
+// Coloring, Kempe chain の表は TableProvider に読み込まれたまま、全てのリクエストで共有される
+void ServeDaemon(const string& socketPath, int workerNum, const std::function<std::optional<EvaluateOptions>(const vector<string>&)>& parseOptions) {
+    int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    auto addr = SocketAddressOf(socketPath);
+    ::unlink(socketPath.c_str());
+    if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listenFd, 64) != 0) {
+        spdlog::critical("Error: Failed to listen on {}", socketPath);
+        throw std::runtime_error("Failed to listen on " + socketPath);
+    }
+    RoutingSink::Install();
+    spdlog::info("Listening on {} with {} workers", socketPath, workerNum);
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<int> pending;
+    vector<std::thread> workers;
+    for (int t = 0; t < workerNum; t++) {
+        workers.emplace_back([&] {
+            while (true) {
+                int fd;
+                {
+                    std::unique_lock lock(mtx);
+                    cv.wait(lock, [&] { return !pending.empty(); });
+                    fd = pending.front();
+                    pending.pop_front();
+                }
+                HandleDaemonRequest(fd, parseOptions);
+                ::close(fd);
+            }
+        });
+    }
+    while (true) {
+        int fd = ::accept(listenFd, nullptr, nullptr);
+        if (fd < 0) continue;
+        std::lock_guard lock(mtx);
+        pending.push_back(fd);
+        cv.notify_one();
+    }
+}
+
+// パスを値に取るオプションの値を絶対パスにする (デーモンの作業ディレクトリではなく、クライアントのものからの相対パスとして扱う)
+vector<string> WithAbsolutePaths(const vector<string>& args) {
+    static const vector<string> pathOptions = {"--feasibles", "-f", "--cache-dir", "--verdict-cache", "--cert-dir", "--checkpoint-dir"};
+    auto absolute = [](const string& path) {
+        return path.empty() ? path : std::filesystem::absolute(path).string();
+    };
+    vector<string> res;
+    for (size_t i = 0; i < args.size(); i++) {
+        auto& arg = args[i];
+        bool rewritten = false;
+        for (auto& option : pathOptions) {
+            if (arg == option && i + 1 < args.size()) {
+                res.push_back(arg);
+                res.push_back(absolute(args[++i]));
+            }
+            else if (option.starts_with("--") && arg.starts_with(option + "=")) {
+                res.push_back(option + "=" + absolute(arg.substr(option.size() + 1)));
+            }
+            else if (!option.starts_with("--") && !arg.starts_with("--") && arg.starts_with(option) && arg.size() > option.size()) {
+                res.push_back(option + absolute(arg.substr(option.size())));
+            }
+            else {
+                continue;
+            }
+            rewritten = true;
+            break;
+        }
+        if (!rewritten) res.push_back(arg);
+    }
+    return res;
+}
+
+// split_unix で元に戻せるように、空白や引用符を含む引数を引用符で囲む
+string QuoteArgument(const string& arg) {
+    if (!arg.empty() && arg.find_first_of(" \t\"'\\") == string::npos) return arg;
+    string res = "\"";
+    for (char c : arg) {
+        if (c == '"' || c == '\\') res += '\\';
+        res += c;
+    }
+    return res + "\"";
+}
+
+// デーモンに confFile の判定を args のオプションで依頼し、返ってきたログを out に出力する
+// デーモンが送ってきた終了コードを返す (接続できない、あるいは終了コードが送られてこなかった場合は 1)
+int RequestDaemon(const string& socketPath, const vector<string>& args, const string& confFile, std::ostream& out) {
+    std::ifstream ifs(confFile);
+    if (!ifs) {
+        spdlog::error("Failed to read {}", confFile);
+        return 1;
+    }
+    std::stringstream request;
+    auto absoluteArgs = WithAbsolutePaths(args);
+    for (size_t i = 0; i < absoluteArgs.size(); i++) {
+        request << (i ? " " : "") << QuoteArgument(absoluteArgs[i]);
+    }
+    request << '\n' << std::filesystem::path(confFile).stem().string() << '\n' << ifs.rdbuf();
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    auto addr = SocketAddressOf(socketPath);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        spdlog::error("Failed to connect to {}", socketPath);
+        if (fd >= 0) ::close(fd);
+        return 1;
+    }
+    auto data = request.str();
+    for (size_t sent = 0; sent < data.size();) {
+        auto n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) break;
+        sent += n;
+    }
+    ::shutdown(fd, SHUT_WR);
+    // ログは行ごとに出力し、終了コードの行だけは出力せずに読み取る
+    std::optional<int> status;
+    string pending;
+    char buffer[1 << 16];
+    auto flushLines = [&](bool all) {
+        size_t start = 0;
+        while (true) {
+            auto end = pending.find('\n', start);
+            if (end == string::npos) break;
+            auto line = std::string_view(pending).substr(start, end + 1 - start);
+            if (line.starts_with(daemonStatusPrefix)) {
+                status = std::atoi(string(line.substr(daemonStatusPrefix.size())).c_str());
+            }
+            else {
+                out << line;
+            }
+            start = end + 1;
+        }
+        pending.erase(0, start);
+        if (all && !pending.empty()) {
+            out << pending;
+            pending.clear();
+        }
+        out.flush();
+    };
+    while (true) {
+        auto n = ::read(fd, buffer, sizeof(buffer));
+        if (n <= 0) break;
+        pending.append(buffer, n);
+        flushLines(false);
+    }
+    flushLines(true);
+    ::close(fd);
+    if (!status) {
+        spdlog::error("The daemon closed the connection without reporting a status");
+        return 1;
+    }
+    return *status;
+}
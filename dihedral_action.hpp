@@ -0,0 +1,133 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+#include "coloring.hpp"
+#include "coloring_table.hpp"
+#include "mapped_file.hpp"
+
+using std::string;
+using std::vector;
+
+// 大きさ n のリングの回転・反転 (二面体群の 2n 個の元) が、Coloring の番号 (Coloring のファイルでの位置) をどの番号に移すかの表
+// 元 g (0 <= g < n: 辺 r を r + g に移す回転, n <= g < 2n: 辺 r を (g - n) - r に移す反転) について、
+// Coloring i を移した Coloring の番号を Row(g)[i] に持つ (Coloring::Permuted と同じ向き)
+// 文字列を作り直して探す代わりに番号の参照だけで済むので、回転・反転で移り合う Coloring の feasibility をまとめる処理に使う
+class DihedralAction {
+    std::shared_ptr<const void> owner;
+    const int32_t* data = nullptr;
+    int ringSize = 0;
+    size_t colorNum = 0;
+public:
+    DihedralAction() = default;
+    DihedralAction(std::shared_ptr<const void> owner, const int32_t* data, int ringSize, size_t colorNum)
+        : owner(std::move(owner)), data(data), ringSize(ringSize), colorNum(colorNum) {}
+    // colorings (リングの大きさ ringSize の Coloring の列) から表を作る
+    // 文字列から求めるのは 1 つずらす回転と辺 0 を固定する反転だけで、他の元はそれを合成して求める
+    static DihedralAction Compute(int ringSize, const ColoringTable& colorings) {
+        size_t colorNum = colorings.size();
+        vector<int> rotation(ringSize), reflection(ringSize);
+        for (int r = 0; r < ringSize; r++) {
+            rotation[r] = (r + 1) % ringSize;
+            reflection[r] = (ringSize - r) % ringSize;
+        }
+        auto table = std::make_shared<vector<int32_t>>(2 * ringSize * colorNum);
+        auto row = [&](int g) { return table->data() + g * colorNum; };
+        for (size_t i = 0; i < colorNum; i++) {
+            row(0)[i] = i;
+            if (ringSize > 1) row(1)[i] = colorings.IndexOf(colorings.At(i).Permuted(rotation).StringOf());
+            row(ringSize)[i] = colorings.IndexOf(colorings.At(i).Permuted(reflection).StringOf());
+        }
+        for (int g = 2; g < ringSize; g++) {
+            for (size_t i = 0; i < colorNum; i++) row(g)[i] = row(1)[row(g - 1)[i]];
+        }
+        // r -> k - r は、r -> -r のあとに k だけ回転させたもの
+        for (int k = 1; k < ringSize; k++) {
+            for (size_t i = 0; i < colorNum; i++) row(ringSize + k)[i] = row(k)[row(ringSize)[i]];
+        }
+        return DihedralAction(table, table->data(), ringSize, colorNum);
+    }
+    int RingSize() const {
+        return ringSize;
+    }
+    size_t ColorNum() const {
+        return colorNum;
+    }
+    int ElementNum() const {
+        return 2 * ringSize;
+    }
+    // リング上の辺 r を perm[r] に移す回転・反転に対応する元
+    int ElementOf(const vector<int>& perm) const {
+        if (ringSize < 3 || perm[1] == (perm[0] + 1) % ringSize) return perm[0];
+        return ringSize + perm[0];
+    }
+    const int32_t* Row(int g) const {
+        return data + g * colorNum;
+    }
+    const int32_t* Data() const {
+        return data;
+    }
+};
+
+// 二面体群の作用の表のファイル (color/cubic/dihedral_<size>.bin) の形式
+// ヘッダのあとに Row(0), Row(1), ..., Row(2n - 1) を int32 で並べる
+// coloringHash が今の Coloring のファイルと一致しない場合は使わない
+struct DihedralFileHeader {
+    char magic[8];
+    int32_t ringSize;
+    uint32_t reserved;
+    uint64_t colorNum;
+    uint64_t coloringHash;
+};
+constexpr char dihedralFileMagic[8] = {'D', 'I', 'H', 'E', 'D', 'R', '0', '1'};
+
+string DihedralFileName(int size) {
+    return "color/cubic/dihedral_" + std::to_string(size) + ".bin";
+}
+
+void WriteDihedralFile(const string& fileName, const DihedralAction& action, uint64_t coloringHash) {
+    std::filesystem::create_directories(std::filesystem::path(fileName).parent_path());
+    auto temporary = fileName + ".tmp." + std::to_string(::getpid());
+    {
+        std::ofstream ofs(temporary, std::ios::binary);
+        if (!ofs) {
+            spdlog::critical("Error: Failed to open {}", temporary);
+            throw std::runtime_error("Error opening " + temporary);
+        }
+        spdlog::info("Writing to {}", fileName);
+        DihedralFileHeader header = {};
+        std::memcpy(header.magic, dihedralFileMagic, sizeof(header.magic));
+        header.ringSize = action.RingSize();
+        header.colorNum = action.ColorNum();
+        header.coloringHash = coloringHash;
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(action.Data()), sizeof(int32_t) * action.ElementNum() * action.ColorNum());
+    }
+    std::filesystem::rename(temporary, fileName);
+}
+
+// ファイルを mmap して表を (コピーせずに) 返す (ファイルがないか、Coloring の列が一致しない場合は std::nullopt)
+std::optional<DihedralAction> LoadDihedralFile(const string& fileName, int ringSize, uint64_t colorNum, uint64_t coloringHash) {
+    if (!std::filesystem::exists(fileName)) return std::nullopt;
+    auto file = std::make_shared<MappedFile>(fileName);
+    DihedralFileHeader header;
+    if (file->size() < sizeof(header)) return std::nullopt;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, dihedralFileMagic, sizeof(header.magic)) != 0 || header.ringSize != ringSize
+        || header.colorNum != colorNum || header.coloringHash != coloringHash
+        || file->size() < sizeof(header) + sizeof(int32_t) * 2 * ringSize * colorNum) {
+        spdlog::warn("{} does not match the color file, regenerating it", fileName);
+        return std::nullopt;
+    }
+    auto data = reinterpret_cast<const int32_t*>(file->data() + sizeof(header));
+    return DihedralAction(file, data, ringSize, colorNum);
+}
@@ -1,70 +1,154 @@
+#pragma once
 #include <fstream>
 #include <iostream>
 #include <string>
-#include <set>
-#include <map>
+#include <optional>
+#include <filesystem>
+#include <algorithm>
 #include <functional>
 #include <tuple>
 #include <vector>
-#include <cassert>
+#include <cstdint>
+#include <stdexcept>
 #include <fmt/core.h>
 #include <spdlog/spdlog.h>
+#include "cubic_conf.hpp"
 
 using std::ifstream;
+using std::istream;
 using std::ostream;
 using std::string;
-using std::set;
-using std::map;
 using std::pair;
 using std::tuple;
 using std::vector;
 
-// 主グラフの辺情報をもとに双対となる 3 正則グラフを返す
-vector<tuple<int, int, int>> GetDuality(int N, int R, set<pair<int, int>>& primalEdges) {
-    auto is3Cycle = [&] (int x, int y, int z) {
-        return primalEdges.count({x, y}) && primalEdges.count({y, z}) && primalEdges.count({z, x});
+// .conf ファイル 1 つ分の主グラフ (頂点 0..R-1 がリングを成し、adjacency は昇順に並べた隣接頂点)
+struct PrimalConf {
+    string name; // 1 行目 (コメント)
+    int N = 0;
+    int R = 0;
+    vector<vector<int>> adjacency;
+};
+
+// is から .conf を 1 つ読む (空行だけが残っている場合は std::nullopt)
+// 複数の .conf をつなげたストリームから順に読み出せる (間の空行は読み飛ばすので、1 行目のコメントは空でないものとする)
+std::optional<PrimalConf> ReadPrimalConf(istream& is) {
+    PrimalConf conf;
+    while (std::getline(is, conf.name)) {
+        if (conf.name.find_first_not_of(" \t\r") != string::npos) break;
+    }
+    if (!is) return std::nullopt;
+    if (!(is >> conf.N >> conf.R) || conf.R <= 0 || conf.N < conf.R) {
+        spdlog::critical("Error: Invalid conf header after \"{}\"", conf.name);
+        throw std::runtime_error("Invalid conf header");
+    }
+    conf.adjacency.resize(conf.N);
+    auto addEdge = [&](int x, int y) {
+        if (x < 0 || x >= conf.N || y < 0 || y >= conf.N || x == y) {
+            spdlog::critical("Error: Invalid edge {}-{} in \"{}\"", x + 1, y + 1, conf.name);
+            throw std::runtime_error("Invalid conf edge");
+        }
+        conf.adjacency[x].push_back(y);
+        conf.adjacency[y].push_back(x);
     };
-    set<tuple<int, int, int>> triangles;
-    for (int i = 0; i < N; i++) {
-        for (int j = 0; j < i; j++) {
-            for (int k = 0; k < j; k++) {
-                if (is3Cycle(k, j, i)) {
-                    spdlog::trace("3c: [{}, {}, {}]", k, j, i);
-                    triangles.insert({k, j, i});
-                }
-            }
+    if (conf.R > 1) {
+        for (int i = 0; i < conf.R; i++) {
+            addEdge(i, (i + 1) % conf.R);
         }
     }
-    map<pair<int, int>, int> indexOfEdge;
-    int counter = 0;
-    auto addEdge = [&] (int x, int y) {
-        if (x > y) std::swap(x, y);
-        if (!indexOfEdge.count({x, y})) {
-            indexOfEdge[{x, y}] = counter++;
+    for (int i = conf.R; i < conf.N; i++) {
+        int x, m;
+        if (!(is >> x >> m)) {
+            spdlog::critical("Error: Missing vertex line in \"{}\"", conf.name);
+            throw std::runtime_error("Invalid conf vertex");
         }
+        for (int j = 0; j < m; j++) {
+            int y;
+            if (!(is >> y)) {
+                spdlog::critical("Error: Missing neighbor of vertex {} in \"{}\"", x, conf.name);
+                throw std::runtime_error("Invalid conf vertex");
+            }
+            addEdge(x - 1, y - 1);
+        }
+    }
+    string rest;
+    std::getline(is, rest);
+    for (auto& neighbors : conf.adjacency) {
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+    }
+    return conf;
+}
+
+// 主グラフの辺情報をもとに双対となる 3 正則グラフを返す
+// 三角形 (k, j, i) (k < j < i) を辞書順に、隣接リストの共通部分から列挙する (平面グラフなら辺数にほぼ比例する時間)
+// 辺の番号はリング上の辺 (i, i+1) を 0..R-1 とし、残りは三角形の順に現れた順につける
+vector<tuple<int, int, int>> GetDuality(const PrimalConf& primal) {
+    auto& adjacency = primal.adjacency;
+    // edgeIndex[x][p]: 辺 (x, adjacency[x][p]) の番号 (-1 なら未定)
+    vector<vector<int>> edgeIndex(primal.N);
+    for (int x = 0; x < primal.N; x++) edgeIndex[x].assign(adjacency[x].size(), -1);
+    auto slotOf = [&](int x, int y) -> int& {
+        auto it = std::lower_bound(adjacency[x].begin(), adjacency[x].end(), y);
+        return edgeIndex[x][it - adjacency[x].begin()];
     };
-    auto getEdge = [&] (int x, int y) {
-        if (x > y) std::swap(x, y);
-        return indexOfEdge.at({x, y});
+    int counter = 0;
+    auto addEdge = [&](int x, int y) {
+        auto& index = slotOf(std::min(x, y), std::max(x, y));
+        if (index < 0) index = counter++;
+        return index;
     };
-    for (int i = 0; i < R; i++) {
-        addEdge(i, (i+1) % R);
+    for (int i = 0; primal.R > 1 && i < primal.R; i++) {
+        addEdge(i, (i + 1) % primal.R);
     }
     vector<tuple<int, int, int>> threes;
-    for (auto tri : triangles) {
-        auto [a,b,c] = tri;
-        addEdge(a, b);
-        addEdge(b, c);
-        addEdge(c, a);
-        threes.push_back({
-            getEdge(a, b),
-            getEdge(b, c),
-            getEdge(c, a)
-        });
+    for (int k = 0; k < primal.N; k++) {
+        for (int j : adjacency[k]) {
+            if (j <= k) continue;
+            // adjacency[k] と adjacency[j] の共通部分のうち j より大きいもの
+            auto p = std::upper_bound(adjacency[k].begin(), adjacency[k].end(), j);
+            auto q = std::upper_bound(adjacency[j].begin(), adjacency[j].end(), j);
+            while (p != adjacency[k].end() && q != adjacency[j].end()) {
+                if (*p < *q) {
+                    ++p;
+                }
+                else if (*q < *p) {
+                    ++q;
+                }
+                else {
+                    int i = *p;
+                    spdlog::trace("3c: [{}, {}, {}]", k, j, i);
+                    int a = addEdge(k, j);
+                    int b = addEdge(j, i);
+                    int c = addEdge(i, k);
+                    threes.push_back({a, b, c});
+                    ++p;
+                    ++q;
+                }
+            }
+        }
     }
     return threes;
 }
 
+// 双対グラフを、頂点 i に接する辺を [3i, 3i+3) に並べた配列にする (CubicConf::fromVertexEdges に渡せる形)
+vector<int32_t> DualVertexEdges(const PrimalConf& primal) {
+    vector<int32_t> edges;
+    for (auto [a, b, c] : GetDuality(primal)) {
+        edges.insert(edges.end(), {a, b, c});
+    }
+    return edges;
+}
+
+void OutputDuality(const PrimalConf& primal, ostream& ofs) {
+    auto threes = GetDuality(primal);
+    ofs << threes.size() << " " << primal.R << '\n';
+    for (auto [a, b, c] : threes) {
+        ofs << a << " " << b << " " << c << '\n';
+    }
+    ofs.flush();
+}
+
 // conf ファイルを読み込み、双対グラフの dconf を ofs に出力する
 void OutputDuality(string confFile, ostream& ofs) {
     ifstream ifs(confFile);
@@ -72,31 +156,45 @@ void OutputDuality(string confFile, ostream& ofs) {
         fmt::print("Failed to read {}", confFile);
         return;
     }
-    string tmp;
-    std::getline(ifs, tmp);
-    int N, R;
-    ifs >> N >> R;
-    set<pair<int, int>> primalEdges;
-    for (int i = 0; i < R; i++) {
-        int j = (i + 1) % R;
-        primalEdges.insert({i, j});
-        primalEdges.insert({j, i});
+    if (auto primal = ReadPrimalConf(ifs)) {
+        OutputDuality(*primal, ofs);
     }
-    for (int i = R; i < N; i++) {
-        int x, m;
-        ifs >> x >> m;
-        x--;
-        for (int j = 0; j < m; j++) {
-            int y;
-            ifs >> y;
-            y--;
-            primalEdges.insert({x, y});
-            primalEdges.insert({y, x});
+}
+
+// sources (.conf ファイル、"-" なら標準入力) に含まれる .conf を順に読み、visit(名前, 主グラフ) を呼ぶ
+// 名前は拡張子を除いたファイル名で、1 つのファイルに複数の .conf が続けて書かれている場合、2 つ目以降は <名前>_<番号> とする
+void ForEachPrimalConf(const vector<string>& sources, const std::function<void(const string&, const PrimalConf&)>& visit) {
+    for (auto& source : sources) {
+        ifstream file;
+        if (source != "-") {
+            file.open(source);
+            if (!file) {
+                spdlog::critical("Error: Failed to read {}", source);
+                throw std::runtime_error("Error reading " + source);
+            }
+        }
+        istream& is = source == "-" ? std::cin : file;
+        string stem = source == "-" ? "stdin" : std::filesystem::path(source).stem().string();
+        for (int count = 0; auto primal = ReadPrimalConf(is); count++) {
+            visit(count == 0 ? stem : fmt::format("{}_{}", stem, count), *primal);
         }
     }
-    auto threes = GetDuality(N, R, primalEdges);
-    ofs << threes.size() << " " << R << std::endl;
-    for (auto [a, b, c] : threes) {
-        ofs << a << " " << b << " " << c << std::endl;
-    }
-}
\ No newline at end of file
+}
+
+// sources の .conf をすべて .dconf に変換し、dconfDir/<名前>.dconf に出力する
+int ConvertConfs(const vector<string>& sources, const string& dconfDir) {
+    std::filesystem::create_directories(dconfDir);
+    int count = 0;
+    ForEachPrimalConf(sources, [&](const string& name, const PrimalConf& primal) {
+        auto fileName = (std::filesystem::path(dconfDir) / (name + ".dconf")).string();
+        std::ofstream ofs(fileName);
+        if (!ofs) {
+            spdlog::critical("Error: Failed to open {}", fileName);
+            throw std::runtime_error("Error opening " + fileName);
+        }
+        OutputDuality(primal, ofs);
+        count++;
+    });
+    spdlog::info("Converted {} configurations into {}", count, dconfDir);
+    return count;
+}
@@ -1,11 +1,14 @@
 #pragma once
 #include <vector>
+#include <deque>
 #include <unordered_set>
 #include <unordered_map>
 #include <string>
 #include <cassert>
 #include <iostream>
 #include <algorithm>
+#include <mutex>
+#include <utility>
 #include <spdlog/spdlog.h>
 using std::vector;
 using std::unordered_set;
@@ -14,6 +17,7 @@ using std::string;
 using std::reverse;
 using std::cout;
 using std::endl;
+using std::pair;
 
 // s と同値な Kempe chain のうち、辞書順最小なものに変更する
 void reassign(string& s) {
@@ -28,36 +32,34 @@ void reassign(string& s) {
     }
 }
 
-// 長さ 2n の valid な括弧列を返す (n > 0)
+// 長さ 2n の valid な括弧列を返す (n >= 0)
+// 括弧列は "(" + A + ")" + B という形に一意に分解できるので、これを使って重複なく列挙し、結果をメモしておく
 // 例：n = 2 の場合 {"(())", "()()"} 
-unordered_set<string> GetValidParens(int n) {
-    assert(n >= 1);
-    if (n == 1) {
-        return {"()"};
-    }
-    unordered_set<string> res;
-    for (int i = 1; i < n; i++) {
-        auto ls = GetValidParens(i);
-        auto rs = GetValidParens(n - i);
-        for (auto& l : ls) {
-            for (auto& r : rs) {
-                res.insert(l + r);
+const vector<string>& GetValidParens(int n) {
+    assert(n >= 0);
+    static std::mutex mtx;
+    static std::deque<vector<string>> memo = {{""}}; // deque なので、要素を追加しても既存の要素への参照は無効にならない
+    std::lock_guard lock(mtx);
+    while ((int)memo.size() <= n) {
+        int m = memo.size();
+        vector<string> res;
+        for (int i = 0; i < m; i++) {
+            for (auto& a : memo[i]) {
+                for (auto& b : memo[m - 1 - i]) {
+                    res.push_back("(" + a + ")" + b);
+                }
             }
         }
+        memo.push_back(std::move(res));
     }
-    auto ms = GetValidParens(n - 1);
-    for (auto& s : ms) {
-        res.insert("(" + s + ")");
-    }
-    return res;
+    return memo[n];
 }
 
-// 長さ 2n のリング上に存在する n 組の Kempe chain の両端を返す
+// 長さ 2n のリング上に存在する n 組の Kempe chain の両端を (辞書順に) 返す
 // 例：n = 2 の場合 {"aabb", "abba"}
-unordered_set<string> GetPlanarKempes(int n) {
-    auto parens = GetValidParens(n);
-    unordered_set<string> res;
-    for (auto s : parens) {
+vector<string> GetPlanarKempes(int n) {
+    vector<string> res;
+    for (auto s : GetValidParens(n)) {
         char a = 'a';
         vector<char> stack;
         for (auto& c : s) {
@@ -70,125 +72,141 @@ unordered_set<string> GetPlanarKempes(int n) {
                 stack.pop_back();
             }
         }
-        res.insert(s);
+        res.push_back(s);
     }
+    std::sort(res.begin(), res.end());
     return res;
 }
 
-// GetPlanarKempes で得られた長さ 2(n-1) の Kempe pairs の任意の区間を反転させる 
-// 例：n = 3 の場合、例えば "aabb" から "ccaabb", "acabcb", "aabcbc" などが得うる
-unordered_set<string> GetFlippedKempes(int n) {
-    if (n == 1) {
-        return {"aa"};
-    }
-    auto kempes = GetPlanarKempes(n - 1);
-    char c = 'a' + n - 1;
-    unordered_set<string> res;
-    for (auto& s : kempes) {
-        for (auto i = 0u; i < s.size(); i++) {
-            for (auto j = i; j <= s.size(); j++) {
-                auto rev = s.substr(i, j - i);
-                reverse(rev.begin(), rev.end());
-                string t = s.substr(0, i) + c + rev + c + s.substr(j, -1);
-                res.insert(t);
-            }
+// s (各文字がちょうど 2 回ずつ現れる) が、交差しない Kempe pair の列になっているか
+bool IsPlanarKempe(const string& s) {
+    vector<char> stack;
+    bool seen[26] = {};
+    for (auto c : s) {
+        if (seen[c - 'a']) {
+            if (stack.empty() || stack.back() != c) return false;
+            stack.pop_back();
+        }
+        else {
+            seen[c - 'a'] = true;
+            stack.push_back(c);
         }
     }
-    return res;
+    return true;
 }
 
-// GetFlippedKempes の同値なものを除去し、射影平面上の Kempe chain を返す
-// 同値なものの例：cababc、abcbca、bacacb など
-unordered_set<string> GetProjectiveKempes(int n) {
-    auto flipped = GetFlippedKempes(n);
-    unordered_set<string> res;
-    for (auto s : flipped) {
-        reassign(s);
-        res.insert(s);
-    }
-    return res;
+// planar な Kempe pairs に Kempe pair を 1 つ追加するとき、その内側の区間をどのように変形するか
+enum class KempeInsertion {
+    Unflipped, // そのまま
+    Flipped, // 反転させる
+    Rotated, // 回転させる
+};
+
+// inner を k だけ変形した文字列
+string TransformInner(const string& inner, KempeInsertion insertion, int k) {
+    switch (insertion) {
+        case KempeInsertion::Unflipped:
+            return inner;
+        case KempeInsertion::Flipped:
+            return string(inner.rbegin(), inner.rend());
+        case KempeInsertion::Rotated:
+            return inner.substr(k) + inner.substr(0, k);
+    }
+    return inner;
 }
 
-// GetPlanarKempes で得られた長さ 2(n-1) の Kempe pairs に一つ (交差しうる) Kempe pair を追加する (Kempe pair 内は反転せずそのまま)
-// 例：n = 3 の場合、例えば "aabb" から "ccaabb", "acbacb", "aabcbc" などが得うる
-unordered_set<string> GetUnflippedKempes(int n) {
-    if (n == 1) {
-        return {"aa"};
+// TransformInner の逆変換
+string UntransformInner(const string& inner, KempeInsertion insertion, int k) {
+    if (insertion == KempeInsertion::Rotated) {
+        return inner.substr(inner.size() - k) + inner.substr(0, inner.size() - k);
     }
-    auto kempes = GetPlanarKempes(n - 1);
-    char c = 'a' + n - 1;
-    unordered_set<string> res;
-    for (auto& s : kempes) {
-        for (auto i = 0u; i < s.size(); i++) {
-            for (auto j = i; j <= s.size(); j++) {
-                auto bop = s.substr(i, j - i);
-                string t = s.substr(0, i) + c + bop + c + s.substr(j, -1);
-                res.insert(t);
-            }
-        }
-    }
-    return res;
+    return TransformInner(inner, insertion, 0);
+}
+
+// planar な Kempe pairs の区間 [i, j) を変形して Kempe pair で挟んだとき、k 通りの変形があるか
+int CountTransforms(int length, KempeInsertion insertion) {
+    return insertion == KempeInsertion::Rotated ? std::max(length, 1) : 1;
 }
 
-// GetUnflippedKempes の同値なものを除去し、Apex グラフ上の Kempe chain を返す
-unordered_set<string> GetApexKempes(int n) {
-    auto flipped = GetUnflippedKempes(n);
-    unordered_set<string> res;
-    for (auto s : flipped) {
-        reassign(s);
-        res.insert(s);
+// t を、planar な Kempe pairs に Kempe pair を 1 つ追加して得る方法 (追加した pair の左端 i, 変形 k) のうち、(i, k) が最小のものを返す
+// 列挙の際にこれと一致する方法で得られたものだけを出力すれば、各 pattern をちょうど 1 回ずつ出力できる (canonical augmentation)
+pair<int, int> CanonicalInsertion(const string& t, KempeInsertion insertion) {
+    for (int i = 0; i + 2 < (int)t.size(); i++) {
+        auto j = t.find(t[i], i + 1);
+        if (t.find(t[i]) != (size_t)i) continue; // pair の左端ではない
+        auto inner = t.substr(i + 1, j - i - 1);
+        for (int k = 0; k < CountTransforms(inner.size(), insertion); k++) {
+            if (IsPlanarKempe(t.substr(0, i) + UntransformInner(inner, insertion, k) + t.substr(j + 1))) {
+                return {i, k};
+            }
+        }
     }
-    return res;
+    assert(false);
+    return {-1, -1};
 }
 
-// GetPlanarKempes で得られた長さ 2(n-1) の Kempe pairs の任意の区間を「回転」させる 
-unordered_set<string> GetRotatedKempes(int n) {
+// GetPlanarKempes で得られた長さ 2(n-1) の Kempe pairs の任意の区間を insertion の方法で変形し、新しい Kempe pair で挟んだものを
+// (同値なものは 1 回だけ) 辞書順最小の形にして返す
+vector<string> GetInsertedKempes(int n, KempeInsertion insertion) {
     if (n == 1) {
         return {"aa"};
     }
     auto kempes = GetPlanarKempes(n - 1);
     char c = 'a' + n - 1;
-    unordered_set<string> res;
+    vector<string> res;
     for (auto& s : kempes) {
         for (auto i = 0u; i < s.size(); i++) {
             for (auto j = i; j <= s.size(); j++) {
                 auto bop = s.substr(i, j - i);
-                for (int k = 0; k < std::max((int)bop.size(), 1); k++) {
-                    string t = s.substr(0, i) + c + bop.substr(k, -1) + bop.substr(0, k) + c + s.substr(j, -1);
-                    //spdlog::info("{}, {}, {}, {}", s, i, j, t);
-                    res.insert(t);
+                for (int k = 0; k < CountTransforms(bop.size(), insertion); k++) {
+                    string t = s.substr(0, i) + c + TransformInner(bop, insertion, k) + c + s.substr(j, -1);
+                    if (CanonicalInsertion(t, insertion) != pair<int, int>(i, k)) continue;
+                    reassign(t);
+                    res.push_back(t);
                 }
             }
         }
     }
+    std::sort(res.begin(), res.end());
     return res;
 }
 
-unordered_set<string> GetToroidalKempes(int n) {
-    auto rotated = GetRotatedKempes(n);
-    unordered_set<string> res;
-    for (auto s : rotated) {
-        reassign(s);
-        res.insert(s);
-    }
-    return res;
+// 射影平面上の Kempe chain を返す
+// GetPlanarKempes で得られた長さ 2(n-1) の Kempe pairs の任意の区間を反転させたもの
+// 例：n = 3 の場合、例えば "aabb" から "ccaabb", "acabcb", "aabcbc" などが得うる
+// 同値なもの (cababc、abcbca、bacacb など) は 1 回だけ返す
+vector<string> GetProjectiveKempes(int n) {
+    return GetInsertedKempes(n, KempeInsertion::Flipped);
 }
 
-unordered_set<string> GetAnnularKempes(int l, int r) {
-    unordered_set<string> res;
+// Apex グラフ上の Kempe chain を返す
+// GetPlanarKempes で得られた長さ 2(n-1) の Kempe pairs に一つ (交差しうる) Kempe pair を追加したもの (Kempe pair 内は反転せずそのまま)
+// 例：n = 3 の場合、例えば "aabb" から "ccaabb", "acbacb", "aabcbc" などが得うる
+vector<string> GetApexKempes(int n) {
+    return GetInsertedKempes(n, KempeInsertion::Unflipped);
+}
+
+// トーラス上の Kempe chain を返す
+// GetPlanarKempes で得られた長さ 2(n-1) の Kempe pairs の任意の区間を「回転」させたもの
+vector<string> GetToroidalKempes(int n) {
+    return GetInsertedKempes(n, KempeInsertion::Rotated);
+}
+
+vector<string> GetAnnularKempes(int l, int r) {
+    vector<string> res;
     for (string s : GetPlanarKempes((l + r) / 2)) {
         string r1 = s.substr(0, l);
         string r2 = s.substr(l, r);
         std::reverse(r2.begin(), r2.end());
         string t = r1 + r2;
         reassign(t);
-        res.insert(t);
+        res.push_back(t);
     }
+    int m = (l + r) / 2 - 1;
+    auto kempes = m ? GetPlanarKempes(m) : vector<string>{""};
+    char c = 'a' + m;
     for (int i = 0; i < l; i++) {
         for (int j = 0; j < r; j++) {
-            int m = (l + r) / 2 - 1;
-            auto kempes = m ? GetPlanarKempes(m) : unordered_set<string>{""};
-            char c = 'a' + m;
             for (auto& s : kempes) {
                 string r1 = s.substr(i, j);
                 string r2 = s.substr(i + j, r - j - 1);
@@ -200,9 +218,12 @@ unordered_set<string> GetAnnularKempes(int l, int r) {
                     std::cerr << s <<" "<< i <<" "<< j<<" " << l <<" "<< r << endl;
                     assert(false);
                 }
-                res.insert(t);
+                res.push_back(t);
             }
         }
     }
+    // annular の場合は同値なものを列挙の途中で判定できないので、ソートして重複を取り除く
+    std::sort(res.begin(), res.end());
+    res.erase(std::unique(res.begin(), res.end()), res.end());
     return res;
-}
\ No newline at end of file
+}
@@ -2,7 +2,15 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <memory>
+#include <optional>
+#include <filesystem>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
 #include <spdlog/spdlog.h>
+#include "mapped_file.hpp"
+#include "hashing.hpp"
 using std::ofstream;
 using std::ifstream;
 using std::vector;
@@ -41,4 +49,128 @@ vector<bool> LoadFeasibles(string fileName) {
         res.push_back(c == '1');
     }
     return res;
-}
\ No newline at end of file
+}
+
+// feasible 列のハッシュ値 (判定結果の証明書で、D-reducibility check の結果が一致するかを確かめるのに使う)
+uint64_t HashFeasibles(const vector<bool>& feasible) {
+    Fnv1a hash;
+    hash.Add((int)feasible.size());
+    uint64_t word = 0;
+    for (size_t i = 0; i < feasible.size(); i++) {
+        if (feasible[i]) word |= uint64_t(1) << (i % 64);
+        if (i % 64 == 63 || i + 1 == feasible.size()) {
+            hash.Add(&word, sizeof(word));
+            word = 0;
+        }
+    }
+    return hash.Value();
+}
+
+// バイナリの feasible file (拡張子 .bin) の形式
+// ヘッダ、各 coloring が feasible かどうかの bitset (uint64 の列、下位ビットから)、D-reducibility check の途中状態 (任意)、の順に並ぶ
+// 途中状態は各 coloring, fix についてどの Kempe chain まで成功したか (int32 が colorNum * 3 個) で、これがあれば続きから check できる
+// ヘッダの値が読み込む側と一致しない (別の Coloring の表や Kempe type で書かれた) ファイルは読み込まない
+struct FeasibleFileHeader {
+    char magic[8];
+    int32_t left; // リングの大きさ (annular の場合は左のリングの大きさ)
+    int32_t right; // annular の場合は右のリングの大きさ、それ以外は 0
+    uint32_t kempeType;
+    uint32_t flags;
+    uint64_t coloringHash; // HashColorings
+    uint64_t confHash; // CubicConf::Hash
+    uint64_t colorNum;
+    uint64_t stateOffset; // 途中状態のファイル先頭からの位置 (なければ 0)
+};
+constexpr char feasibleFileMagic[8] = {'F', 'E', 'A', 'S', 'I', 'B', '0', '1'};
+constexpr uint32_t feasibleRotated = 1; // リングの回転で移り合う coloring の feasibility をまとめたもの (--rotate-f)
+
+bool IsBinaryFeasibleFile(const string& fileName) {
+    return std::filesystem::path(fileName).extension() == ".bin";
+}
+
+// header の内容で feasible とその途中状態 kempeIndexes (nullptr なら含めない) をバイナリで出力する
+// 一時ファイルに書いてから rename するので、読み込み中のファイルに上書きしてもよい
+void WriteFeasibleFile(const string& fileName, FeasibleFileHeader header, const vector<bool>& feasible, const vector<vector<int>>* kempeIndexes) {
+    std::memcpy(header.magic, feasibleFileMagic, sizeof(header.magic));
+    header.colorNum = feasible.size();
+    vector<uint64_t> words((feasible.size() + 63) / 64);
+    for (size_t i = 0; i < feasible.size(); i++) {
+        if (feasible[i]) words[i / 64] |= uint64_t(1) << (i % 64);
+    }
+    header.stateOffset = kempeIndexes ? sizeof(header) + sizeof(uint64_t) * words.size() : 0;
+    auto temporary = fileName + ".tmp";
+    {
+        ofstream ofs(temporary, std::ios::binary);
+        if (!ofs) {
+            spdlog::critical("Error: Failed to open {}", temporary);
+            throw std::runtime_error("Error opening " + temporary);
+        }
+        spdlog::debug("Writing feasibles to {}", fileName);
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(words.data()), sizeof(uint64_t) * words.size());
+        if (kempeIndexes) {
+            vector<int32_t> state;
+            state.reserve(kempeIndexes->size() * 3);
+            for (auto& indexes : *kempeIndexes) state.insert(state.end(), indexes.begin(), indexes.end());
+            ofs.write(reinterpret_cast<const char*>(state.data()), sizeof(int32_t) * state.size());
+        }
+        if (!ofs) {
+            spdlog::critical("Error: Failed to write {}", temporary);
+            throw std::runtime_error("Error writing " + temporary);
+        }
+    }
+    std::filesystem::rename(temporary, fileName);
+}
+
+// バイナリの feasible file を mmap したもの
+class FeasibleFile {
+    std::shared_ptr<MappedFile> file;
+    FeasibleFileHeader header;
+    const uint64_t* Words() const {
+        return reinterpret_cast<const uint64_t*>(file->data() + sizeof(FeasibleFileHeader));
+    }
+public:
+    explicit FeasibleFile(const string& fileName) : file(std::make_shared<MappedFile>(fileName)) {
+        spdlog::debug("Reading feasibles from {}", fileName);
+        bool valid = file->size() >= sizeof(header);
+        if (valid) {
+            std::memcpy(&header, file->data(), sizeof(header));
+            uint64_t bitsEnd = sizeof(header) + sizeof(uint64_t) * ((header.colorNum + 63) / 64);
+            valid = std::memcmp(header.magic, feasibleFileMagic, sizeof(header.magic)) == 0 && file->size() >= bitsEnd
+                && (header.stateOffset == 0 || (header.stateOffset >= bitsEnd && header.stateOffset + sizeof(int32_t) * 3 * header.colorNum <= file->size()));
+        }
+        if (!valid) {
+            spdlog::critical("Error: {} is not a valid feasible file", fileName);
+            throw std::runtime_error("Error reading " + fileName);
+        }
+    }
+    const FeasibleFileHeader& Header() const {
+        return header;
+    }
+    // expected と同じ configuration, Kempe type, Coloring の表で書かれたものか確認する
+    void Check(const FeasibleFileHeader& expected, const string& fileName) const {
+        auto mismatch = [&](const string& what) {
+            spdlog::critical("Error: {} was written for a different {}", fileName, what);
+            throw std::runtime_error("Mismatched feasible file " + fileName);
+        };
+        if (header.left != expected.left || header.right != expected.right) mismatch("ring size");
+        if (header.kempeType != expected.kempeType) mismatch("Kempe type");
+        if (header.confHash != expected.confHash) mismatch("configuration");
+        if (header.coloringHash != expected.coloringHash) mismatch("coloring table (color/)");
+    }
+    bool Test(size_t i) const {
+        return (Words()[i / 64] >> (i % 64)) & 1;
+    }
+    vector<bool> Bits() const {
+        vector<bool> res(header.colorNum);
+        for (size_t i = 0; i < res.size(); i++) res[i] = Test(i);
+        return res;
+    }
+    std::optional<vector<vector<int>>> KempeIndexes() const {
+        if (header.stateOffset == 0) return std::nullopt;
+        auto state = reinterpret_cast<const int32_t*>(file->data() + header.stateOffset);
+        vector<vector<int>> res(header.colorNum);
+        for (size_t i = 0; i < res.size(); i++) res[i] = {state[i * 3], state[i * 3 + 1], state[i * 3 + 2]};
+        return res;
+    }
+};
@@ -1,30 +1,70 @@
 #pragma once
 #include "coloring.hpp"
+#include "coloring_table.hpp"
+#include "hashing.hpp"
+#include "thread_pool.hpp"
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <filesystem>
+#include <unistd.h>
 using std::cout;
 using std::endl;
 using std::ofstream;
 using std::ifstream;
 
-void GenerateColors(int max_size) {
+string ColorFileName(int size) {
+    return "color/cubic/colors_" + std::to_string(size) + ".txt";
+}
+
+// 一時ファイルに書いてから rename するので、他のプロセスが書き込み途中のファイルを読むことはない
+void WriteColorFile(int size, const vector<Coloring>& colorings) {
+    std::filesystem::create_directories("color/cubic");
+    auto filename = ColorFileName(size);
+    auto temporary = filename + ".tmp." + std::to_string(::getpid());
+    {
+        ofstream ofs(temporary);
+        spdlog::info("Writing to {}", filename);
+        ofs << colorings.size() << '\n';
+        for (auto& col : colorings) {
+            ofs << col.StringOf() << '\n';
+        }
+        if (!ofs.flush()) {
+            spdlog::critical("Error: Failed to write {}", temporary);
+            throw std::runtime_error("Error writing " + temporary);
+        }
+    }
+    std::filesystem::rename(temporary, filename);
+}
+
+// リングの大きさ size の Coloring を 1 つずつ生成しながらファイルに書き出す (全体をメモリに持たない)
+// 先頭行の個数を書くために、一度数えてから書き出す
+void GenerateColorFile(int size) {
     std::filesystem::create_directories("color/cubic");
-    for (int s = 1; s <= max_size; s++) {
-        auto res = Coloring::GetValidColorings(s);
-        auto filename = "color/cubic/colors_" + std::to_string(s) + ".txt";
-        ofstream ofs(filename);
+    long long count = 0;
+    Coloring::ForEachValidColoring(size, [&](const string&) { count++; });
+    auto filename = ColorFileName(size);
+    auto temporary = filename + ".tmp." + std::to_string(::getpid());
+    {
+        ofstream ofs(temporary);
         spdlog::info("Writing to {}", filename);
-        ofs << res.size() << endl;
-        for (auto& col : res) {
-            ofs << col.StringOf() << endl;
+        ofs << count << '\n';
+        Coloring::ForEachValidColoring(size, [&](const string& str) { ofs << str << '\n'; });
+        if (!ofs.flush()) {
+            spdlog::critical("Error: Failed to write {}", temporary);
+            throw std::runtime_error("Error writing " + temporary);
         }
     }
+    std::filesystem::rename(temporary, filename);
+}
+
+// 大きさ max_size までの Coloring のファイルを作る (大きさごとに独立なので threadNum 個のスレッドで並列に作る)
+void GenerateColors(int max_size, int threadNum = DefaultThreadNum()) {
+    RunInParallel(max_size, threadNum, [&](int i) { GenerateColorFile(max_size - i); });
 }
 
 vector<Coloring> LoadColorFile(int size) {
-    auto filename = "color/cubic/colors_" + std::to_string(size) + ".txt";
+    auto filename = ColorFileName(size);
     ifstream ifs(filename);
     if (!ifs) {
         spdlog::critical("Error: Failed to open {}", filename);
@@ -41,4 +81,15 @@ vector<Coloring> LoadColorFile(int size) {
         res.push_back(Coloring(str));
     }
     return res;
+}
+
+// Coloring の並び順も含めたハッシュ値 (feasible の列などがどの Coloring の列に対応するかの確認に使う)
+uint64_t HashColorings(const ColoringTable& colorings) {
+    Fnv1a hash;
+    hash.Add((int)colorings.size());
+    for (size_t i = 0; i < colorings.size(); i++) {
+        auto coloring = colorings[i];
+        hash.Add(coloring.data(), coloring.size());
+    }
+    return hash.Value();
 }
\ No newline at end of file
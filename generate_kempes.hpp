@@ -1,8 +1,12 @@
 #pragma once
 #include "edge_kempes.hpp"
+#include "thread_pool.hpp"
+#include "kempe_store.hpp"
 #include <fstream>
 #include <spdlog/spdlog.h>
 #include <filesystem>
+#include <functional>
+#include <unistd.h>
 using std::ifstream;
 using std::ofstream;
 
@@ -10,72 +14,94 @@ enum KempeType {
     Planar, Projective, Apex, Toroidal
 };
 
-void GenerateKempes(int max_size) {
+const char* KempeTypeName(KempeType type) {
+    switch (type) {
+        case Planar: return "Planar";
+        case Projective: return "Projective";
+        case Apex: return "Apex";
+        case Toroidal: return "Toroidal";
+    }
+    return "Unknown";
+}
+
+// Kempe chain の一覧をテキストとして出力
+// 一時ファイルに書いてから rename するので、他のプロセスが書き込み途中のファイルを読むことはない
+void WriteKempeFile(const string& filename, const vector<string>& kempes) {
+    auto temporary = filename + ".tmp." + std::to_string(::getpid());
+    {
+        ofstream ofs(temporary);
+        spdlog::info("Writing to {}", filename);
+        ofs << kempes.size() << '\n';
+        for (auto& s : kempes) {
+            ofs << s << '\n';
+        }
+        if (!ofs.flush()) {
+            spdlog::critical("Error: Failed to write {}", temporary);
+            throw std::runtime_error("Error writing " + temporary);
+        }
+    }
+    std::filesystem::rename(temporary, filename);
+}
+
+const char* KempeFolderName(KempeType type) {
+    return (type == Planar) ? "plan" : (type == Projective) ? "proj" : (type == Apex) ? "apex" : "tori";
+}
+
+string KempeFileName(int size, KempeType type) {
+    return string("kempes/") + KempeFolderName(type) + "/kempes_" + std::to_string(size) + ".txt";
+}
+
+string AnnularKempeFileName(int leftSize, int rightSize) {
+    return "kempes/annu/kempes_" + std::to_string(leftSize) + "_" + std::to_string(rightSize) + ".txt";
+}
+
+// 大きさ max_size までの Kempe chain のファイルを作る
+// 大きさ・種類ごとに独立なので threadNum 個のスレッドで並列に作る (各ファイルの中身はソート済みなので、実行ごとに同じになる)
+// テキストファイルに加えて、種類ごとに全ての大きさをまとめたバイナリファイル (kempes/<種類>.bin) も作る
+void GenerateKempes(int max_size, int threadNum = DefaultThreadNum()) {
     std::filesystem::create_directories("kempes/plan");
     std::filesystem::create_directories("kempes/proj");
     std::filesystem::create_directories("kempes/apex");
     std::filesystem::create_directories("kempes/tori");
     std::filesystem::create_directories("kempes/annu");
-    for (int s = 1; s <= max_size; s++) {
-        {
-            auto res = GetPlanarKempes(s);
-            auto filename = "kempes/plan/kempes_" + std::to_string(s) + ".txt";
-            ofstream ofs(filename);
-            spdlog::info("Writing to {}", filename);
-            ofs << res.size() << endl;
-            for (auto& s : res) {
-                ofs << s << endl;
-            }
-        }
-        {
-            auto res = GetProjectiveKempes(s);
-            auto filename = "kempes/proj/kempes_" + std::to_string(s) + ".txt";
-            ofstream ofs(filename);
-            spdlog::info("Writing to {}", filename);
-            ofs << res.size() << endl;
-            for (auto& s : res) {
-                ofs << s << endl;
-            }
+    struct Task {
+        uint32_t type; // KempeType または annularKempeStoreType
+        int left, right;
+        std::function<vector<string>()> generate;
+        vector<string> result;
+    };
+    vector<Task> tasks;
+    // 時間のかかる大きいものから始める
+    for (int s = max_size; s >= 1; s--) {
+        tasks.push_back({Toroidal, s, 0, [s] { return GetToroidalKempes(s); }, {}});
+        tasks.push_back({Apex, s, 0, [s] { return GetApexKempes(s); }, {}});
+        tasks.push_back({Projective, s, 0, [s] { return GetProjectiveKempes(s); }, {}});
+        tasks.push_back({Planar, s, 0, [s] { return GetPlanarKempes(s); }, {}});
+        for (int l = 1; l < s * 2; l++) {
+            int r = s * 2 - l;
+            tasks.push_back({annularKempeStoreType, l, r, [l, r] { return GetAnnularKempes(l, r); }, {}});
         }
-        {
-            auto res = GetApexKempes(s);
-            auto filename = "kempes/apex/kempes_" + std::to_string(s) + ".txt";
-            ofstream ofs(filename);
-            spdlog::info("Writing to {}", filename);
-            ofs << res.size() << endl;
-            for (auto& s : res) {
-                ofs << s << endl;
-            }
-        }
-        {
-            auto res = GetToroidalKempes(s);
-            auto filename = "kempes/tori/kempes_" + std::to_string(s) + ".txt";
-            ofstream ofs(filename);
-            spdlog::info("Writing to {}", filename);
-            ofs << res.size() << endl;
-            for (auto& s : res) {
-                ofs << s << endl;
-            }
+    }
+    RunInParallel(tasks.size(), threadNum, [&](int i) {
+        auto& task = tasks[i];
+        task.result = task.generate();
+        if (task.type == annularKempeStoreType) {
+            WriteKempeFile(AnnularKempeFileName(task.left, task.right), task.result);
+        } else {
+            WriteKempeFile(KempeFileName(task.left, KempeType(task.type)), task.result);
         }
-        {
-            for (int l = 1; l < s * 2; l++) {
-                int r = s * 2 - l;
-                auto res = GetAnnularKempes(l, r);
-                auto filename = "kempes/annu/kempes_" + std::to_string(l) + "_" + std::to_string(r) + ".txt";
-                ofstream ofs(filename);
-                spdlog::info("Writing to {}", filename);
-                ofs << res.size() << endl;
-                for (auto& s : res) {
-                    ofs << s << endl;
-                }
-            }
+    });
+    for (uint32_t type : {uint32_t(Planar), uint32_t(Projective), uint32_t(Apex), uint32_t(Toroidal), annularKempeStoreType}) {
+        vector<std::tuple<int, int, vector<string>>> tables;
+        for (auto& task : tasks) {
+            if (task.type == type) tables.emplace_back(task.left, task.right, std::move(task.result));
         }
+        auto folderName = (type == annularKempeStoreType) ? "annu" : KempeFolderName(KempeType(type));
+        WriteKempeStore(string("kempes/") + folderName + ".bin", type, tables);
     }
 }
 
-vector<string> LoadKempeFile(int size, KempeType type) {
-    auto folderName = (type == Planar) ? "plan" : (type == Projective) ? "proj" : (type == Apex) ? "apex" : "tori";
-    auto filename = string("kempes/") + folderName + string("/kempes_") + std::to_string(size) + ".txt";
+vector<string> LoadKempeTextFile(const string& filename) {
     ifstream ifs(filename);
     if (!ifs) {
         spdlog::critical("Error: Failed to open {}", filename);
@@ -94,23 +120,10 @@ vector<string> LoadKempeFile(int size, KempeType type) {
     return res;
 }
 
+vector<string> LoadKempeFile(int size, KempeType type) {
+    return LoadKempeTextFile(KempeFileName(size, type));
+}
+
 vector<string> LoadAnnularKempeFile(int leftSize, int rightSize) {
-    auto folderName = "kempes/annu";
-    auto filename = folderName + string("/kempes_") + std::to_string(leftSize) + "_" + std::to_string(rightSize) + ".txt";
-    ifstream ifs(filename);
-    if (!ifs) {
-        spdlog::critical("Error: Failed to open {}", filename);
-        throw std::runtime_error("Failed to open " + filename);
-    }
-    spdlog::debug("Reading from {}", filename);
-    int len;
-    ifs >> len;
-    assert(len >= 0);
-    vector<string> res;
-    for (int i = 0; i < len; i++) {
-        string str;
-        ifs >> str;
-        res.push_back(str);
-    }
-    return res;
-}
\ No newline at end of file
+    return LoadKempeTextFile(AnnularKempeFileName(leftSize, rightSize));
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 64 bit FNV-1a ハッシュ (ファイルの整合性確認やキャッシュのキーに使う)
+class Fnv1a {
+    uint64_t value = 14695981039346656037ull;
+public:
+    void Add(const void* data, size_t size) {
+        auto bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            value ^= bytes[i];
+            value *= 1099511628211ull;
+        }
+    }
+    void Add(int x) {
+        Add(&x, sizeof(x));
+    }
+    void Add(const std::string& str) {
+        Add(str.data(), str.size());
+    }
+    uint64_t Value() const {
+        return value;
+    }
+};
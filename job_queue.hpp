@@ -0,0 +1,174 @@
+#pragma once
+#include <string>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <spdlog/spdlog.h>
+
+using std::string;
+
+// 複数のプロセス (別のマシンでもよい) で同じ configuration の集合を分担して判定するための、ディレクトリ上のジョブキュー
+// configuration <name> について、ディレクトリ dir に
+//   <name>.lease : 判定中のプロセスが O_EXCL で作るファイル。判定中は heartbeat として定期的に更新時刻を更新する
+//   <name>.log   : 判定の結果 (ログ)。一時ファイルに書いてから rename するので、存在すれば判定は完了している
+//   <name>.budget, <name>.budget.log : 時間・メモリの予算を使い切って中断したときの予算とログ。より大きい予算のプロセスだけがやり直す
+//   <name>.failed.log : 例外で失敗したときのログ。失敗はメモリ不足や書き込みの失敗など一時的なこともあるので、完了とはせず再実行したプロセスがやり直す
+// を置く。更新時刻が timeout 以上古い lease は、そのプロセスが途中で止まったものとみなして奪う
+// 途中で止まっても、同じコマンドを再実行すれば完了していないものだけが判定される
+class JobQueue {
+    std::filesystem::path dir;
+    std::chrono::seconds timeout;
+    std::mutex mtx;
+    std::set<string> held; // このプロセスが持っている lease
+    bool stopping = false;
+    std::condition_variable cv;
+    std::thread heartbeat;
+    string owner; // lease に書き込む、このプロセスを表す文字列
+
+    std::filesystem::path LeasePath(const string& name) const {
+        return dir / (name + ".lease");
+    }
+    bool CreateLease(const string& name) {
+        int fd = ::open(LeasePath(name).c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) return false;
+        [[maybe_unused]] auto written = ::write(fd, owner.data(), owner.size());
+        ::close(fd);
+        return true;
+    }
+    void Touch(const string& name) {
+        ::utimensat(AT_FDCWD, LeasePath(name).c_str(), nullptr, 0);
+    }
+    void HeartbeatLoop() {
+        std::unique_lock lock(mtx);
+        while (!cv.wait_for(lock, timeout / 3, [&] { return stopping; })) {
+            for (auto& name : held) {
+                Touch(name);
+            }
+        }
+    }
+public:
+    JobQueue(const string& dirName, int timeoutSeconds) : dir(dirName), timeout(std::max(3, timeoutSeconds)) {
+        std::filesystem::create_directories(dir);
+        char host[256] = {};
+        ::gethostname(host, sizeof(host) - 1);
+        owner = string(host) + " " + std::to_string(::getpid()) + "\n";
+        heartbeat = std::thread([this] { HeartbeatLoop(); });
+    }
+    ~JobQueue() {
+        {
+            std::lock_guard lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        heartbeat.join();
+        std::lock_guard lock(mtx);
+        for (auto& name : held) {
+            std::filesystem::remove(LeasePath(name));
+        }
+    }
+    JobQueue(const JobQueue&) = delete;
+    JobQueue& operator=(const JobQueue&) = delete;
+
+    std::filesystem::path ResultPath(const string& name) const {
+        return dir / (name + ".log");
+    }
+    // 結果を書き込む一時ファイル (Complete で ResultPath に rename する)
+    std::filesystem::path TemporaryResultPath(const string& name) const {
+        char host[256] = {};
+        ::gethostname(host, sizeof(host) - 1);
+        return dir / (name + ".log.tmp." + host + "." + std::to_string(::getpid()));
+    }
+    bool IsDone(const string& name) const {
+        return std::filesystem::exists(ResultPath(name));
+    }
+    std::filesystem::path OverBudgetResultPath(const string& name) const {
+        return dir / (name + ".budget.log");
+    }
+    std::filesystem::path FailedResultPath(const string& name) const {
+        return dir / (name + ".failed.log");
+    }
+    // 予算 (timeBudget 秒, memoryBudgetMb MiB、0 は無制限) 以上の予算で既に中断されているか
+    // (どちらかの予算がより大きければやり直す価値があるので false)
+    bool IsOverBudget(const string& name, double timeBudget, int64_t memoryBudgetMb) const {
+        std::ifstream ifs(dir / (name + ".budget"));
+        double time = 0;
+        int64_t memory = 0;
+        if (!(ifs >> time >> memory)) return false;
+        bool largerTime = time > 0 && (timeBudget <= 0 || timeBudget > time);
+        bool largerMemory = memory > 0 && (memoryBudgetMb <= 0 || memoryBudgetMb > memory);
+        return !largerTime && !largerMemory;
+    }
+    // name の lease を取る。既に完了しているか、他のプロセスが判定中なら false を返す
+    bool TryAcquire(const string& name) {
+        if (IsDone(name)) return false;
+        if (!CreateLease(name)) {
+            std::error_code ec;
+            auto lastWrite = std::filesystem::last_write_time(LeasePath(name), ec);
+            if (ec || std::filesystem::file_time_type::clock::now() - lastWrite < timeout) return false;
+            // 古い lease は rename で退避してから取り直す (rename に成功するのは 1 つのプロセスだけ)
+            auto stale = LeasePath(name).string() + ".stale." + std::to_string(::getpid());
+            if (::rename(LeasePath(name).c_str(), stale.c_str()) != 0) return false;
+            // 確認してから rename するまでに他のプロセスが取り直した新しい lease だった場合は元に戻す
+            // (戻すまでの間に別のプロセスが lease を作ると同じ configuration を重複して判定するが、結果は同じなので問題ない)
+            auto staleWrite = std::filesystem::last_write_time(stale, ec);
+            if (!ec && std::filesystem::file_time_type::clock::now() - staleWrite < timeout) {
+                ::link(stale.c_str(), LeasePath(name).c_str());
+                std::filesystem::remove(stale, ec);
+                return false;
+            }
+            std::filesystem::remove(stale, ec);
+            spdlog::warn("Took over the stale lease of {}", name);
+            if (!CreateLease(name)) return false;
+        }
+        // lease を取る直前に他のプロセスが完了させた場合
+        if (IsDone(name)) {
+            std::filesystem::remove(LeasePath(name));
+            return false;
+        }
+        std::lock_guard lock(mtx);
+        held.insert(name);
+        return true;
+    }
+    // 一時ファイルに書いた結果を確定させ、lease を手放す
+    void Complete(const string& name, const std::filesystem::path& temporaryResult) {
+        std::filesystem::rename(temporaryResult, ResultPath(name));
+        std::error_code ec;
+        std::filesystem::remove(dir / (name + ".budget"), ec);
+        std::filesystem::remove(OverBudgetResultPath(name), ec);
+        std::filesystem::remove(FailedResultPath(name), ec);
+        Release(name);
+    }
+    // 失敗した結果を残して lease を手放す (完了とはしないので、再実行したプロセスがやり直す)
+    void ReleaseFailed(const string& name, const std::filesystem::path& temporaryResult) {
+        std::filesystem::rename(temporaryResult, FailedResultPath(name));
+        Release(name);
+    }
+    // 予算を使い切って中断した結果を、その予算とともに残して lease を手放す (より大きい予算のプロセスがやり直す)
+    void ReleaseOverBudget(const string& name, const std::filesystem::path& temporaryResult, double timeBudget, int64_t memoryBudgetMb) {
+        std::filesystem::rename(temporaryResult, OverBudgetResultPath(name));
+        auto budgetPath = dir / (name + ".budget");
+        auto temporary = budgetPath.string() + ".tmp." + std::to_string(::getpid());
+        {
+            std::ofstream ofs(temporary);
+            ofs << timeBudget << " " << memoryBudgetMb << "\n";
+        }
+        std::filesystem::rename(temporary, budgetPath);
+        Release(name);
+    }
+    // 結果を確定させずに lease を手放す (他のプロセスがやり直す)
+    void Release(const string& name) {
+        std::lock_guard lock(mtx);
+        held.erase(name);
+        std::error_code ec;
+        std::filesystem::remove(LeasePath(name), ec);
+    }
+};
@@ -0,0 +1,160 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <fstream>
+#include <filesystem>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <optional>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+#include "mapped_file.hpp"
+
+using std::string;
+using std::vector;
+
+// 同じ長さの Kempe chain の列を、1 つの位置につき 1 文字 (chain の番号 'a', 'b', ...) として連続した領域に並べたもの
+// 領域は mmap したファイルか、テキストファイルから読み込んだ文字列で、owner が保持している
+class KempeTable {
+    std::shared_ptr<const void> owner;
+    const char* data = nullptr;
+    size_t count = 0;
+    int width = 0;
+public:
+    KempeTable() = default;
+    KempeTable(std::shared_ptr<const void> owner, const char* data, size_t count, int width)
+        : owner(std::move(owner)), data(data), count(count), width(width) {}
+    // 長さの等しい Kempe chain の列を 1 つの領域に詰めた KempeTable を作る
+    static KempeTable FromStrings(const vector<string>& kempes) {
+        int width = kempes.empty() ? 0 : kempes[0].size();
+        auto buffer = std::make_shared<string>();
+        buffer->reserve(kempes.size() * width);
+        for (auto& kempe : kempes) {
+            assert((int)kempe.size() == width);
+            *buffer += kempe;
+        }
+        return KempeTable(buffer, buffer->data(), kempes.size(), width);
+    }
+    size_t size() const {
+        return count;
+    }
+    int Width() const {
+        return width;
+    }
+    std::string_view operator[](size_t i) const {
+        return std::string_view(data + i * width, width);
+    }
+};
+
+// Kempe chain のバイナリファイル (kempes/<種類>.bin) の形式
+// ヘッダ、索引 (大きさごとの KempeStoreEntry)、Kempe chain を固定長で並べたもの、の順に並ぶ
+// 非 annular の場合 (left, right) = (Kempe pair の個数, 0)、annular の場合 (left, right) = (左右のリングの大きさ)
+struct KempeStoreHeader {
+    char magic[8];
+    uint32_t type;
+    uint32_t entryNum;
+};
+struct KempeStoreEntry {
+    int32_t left;
+    int32_t right;
+    uint32_t width;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t offset; // ファイル先頭からの位置
+};
+constexpr char kempeStoreMagic[8] = {'K', 'E', 'M', 'P', 'E', 'S', '0', '1'};
+constexpr uint32_t annularKempeStoreType = 4;
+
+// (left, right, Kempe chain の列) の一覧をバイナリファイルとして出力
+// 一時ファイルに書いてから rename するので、他のプロセスが書き込み途中のファイルを mmap することはない
+void WriteKempeStore(const string& fileName, uint32_t type, const vector<std::tuple<int, int, vector<string>>>& tables) {
+    auto temporary = fileName + ".tmp." + std::to_string(::getpid());
+    std::ofstream ofs(temporary, std::ios::binary);
+    if (!ofs) {
+        spdlog::critical("Error: Failed to open {}", temporary);
+        throw std::runtime_error("Error opening " + temporary);
+    }
+    spdlog::info("Writing to {}", fileName);
+    KempeStoreHeader header = {};
+    std::memcpy(header.magic, kempeStoreMagic, sizeof(header.magic));
+    header.type = type;
+    header.entryNum = tables.size();
+    vector<KempeStoreEntry> entries;
+    uint64_t offset = sizeof(KempeStoreHeader) + sizeof(KempeStoreEntry) * tables.size();
+    for (auto& [left, right, kempes] : tables) {
+        KempeStoreEntry entry = {};
+        entry.left = left;
+        entry.right = right;
+        entry.width = kempes.empty() ? 0 : kempes[0].size();
+        entry.count = kempes.size();
+        entry.offset = offset;
+        offset += entry.width * entry.count;
+        entries.push_back(entry);
+    }
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(entries.data()), sizeof(KempeStoreEntry) * entries.size());
+    for (auto& [left, right, kempes] : tables) {
+        for (auto& kempe : kempes) {
+            ofs.write(kempe.data(), kempe.size());
+        }
+    }
+    ofs.close();
+    if (!ofs) {
+        spdlog::critical("Error: Failed to write {}", temporary);
+        throw std::runtime_error("Error writing " + temporary);
+    }
+    std::filesystem::rename(temporary, fileName);
+}
+
+// mmap したバイナリファイル file の索引を読み、種類 type の (left, right) の Kempe chain の列を (コピーせずに) 返す
+// (left, right) が含まれていない場合は std::nullopt を返す
+// 別の種類の Kempe chain のファイルを使うと判定が誤るので、ヘッダの種類が type と異なる場合はエラーにする
+std::optional<KempeTable> FindInMappedKempeStore(const std::shared_ptr<MappedFile>& file, const string& fileName, uint32_t type, int left, int right) {
+    KempeStoreHeader header;
+    if (file->size() < sizeof(header)) return std::nullopt;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, kempeStoreMagic, sizeof(header.magic)) != 0 || file->size() < sizeof(header) + sizeof(KempeStoreEntry) * header.entryNum) {
+        spdlog::warn("{} is not a valid Kempe chain file", fileName);
+        return std::nullopt;
+    }
+    if (header.type != type) {
+        spdlog::critical("Error: {} holds the Kempe chains of another type ({} instead of {})", fileName, header.type, type);
+        throw std::runtime_error("Kempe chain type mismatch in " + fileName);
+    }
+    for (uint32_t i = 0; i < header.entryNum; i++) {
+        KempeStoreEntry entry;
+        std::memcpy(&entry, file->data() + sizeof(header) + sizeof(KempeStoreEntry) * i, sizeof(entry));
+        if (entry.left != left || entry.right != right) continue;
+        if (entry.offset + entry.width * entry.count > file->size()) {
+            spdlog::warn("{} is truncated", fileName);
+            return std::nullopt;
+        }
+        return KempeTable(file, file->data() + entry.offset, entry.count, entry.width);
+    }
+    return std::nullopt;
+}
+
+// バイナリファイルを mmap し、(left, right) の Kempe chain の列を (コピーせずに) 返す
+// mmap したファイルはプロセスの中で使い回す
+// ファイルがない、あるいは (left, right) が含まれていない場合は std::nullopt を返す
+std::optional<KempeTable> FindInKempeStore(const string& fileName, uint32_t type, int left, int right) {
+    static std::mutex mtx;
+    static std::map<string, std::shared_ptr<MappedFile>> mapped;
+    std::shared_ptr<MappedFile> file;
+    {
+        std::lock_guard lock(mtx);
+        if (!mapped.count(fileName)) {
+            if (!std::filesystem::exists(fileName)) return std::nullopt;
+            spdlog::debug("Mapping {}", fileName);
+            mapped[fileName] = std::make_shared<MappedFile>(fileName);
+        }
+        file = mapped.at(fileName);
+    }
+    return FindInMappedKempeStore(file, fileName, type, left, right);
+}
@@ -1,6 +1,8 @@
 #include "generate_kempes.hpp"
 #include "generate_colors.hpp"
 #include "check_reducibility.hpp"
+#include "batch.hpp"
+#include "daemon.hpp"
 #include "duality.hpp"
 
 #include <boost/tokenizer.hpp>
@@ -8,15 +10,20 @@
 #include <spdlog/spdlog.h>
 #include <fmt/core.h>
 #include <exception>
+#include <thread>
+#include <algorithm>
 
-int main(const int ac, const char* const* const av) {
-    using namespace boost::program_options;
+using namespace boost::program_options;
+
+options_description MakeOptionsDescription() {
     options_description description("Options");
     description.add_options()
         ("kempe,k", value<int>()->default_value(0), "Number of kempe files to generate")
         ("color,c", value<int>()->default_value(0), "Number of color files to generate")
         ("input,i", value<string>(), "The file to evaluate")
-        ("duality,d", "Convert a conf file to dconf")
+        ("duality,d", "Convert a conf file to dconf (with several conf files or - for a stream on stdin, write them to --dconf-dir)")
+        ("dconf-dir", value<string>()->default_value(""), "Directory to write the dconf files converted by -d from several conf files to")
+        ("from-conf", "Evaluate conf files (a single one, several, or - for a stream on stdin) directly, converting them to dconf in memory")
         ("planar,l", "Evaluate the dconf file in planar mode")
         ("apex,a", "Evaluate the dconf file in apex mode")
         ("toroidal,t", "Evaluate the dconf file in toroidal mode")
@@ -30,8 +37,119 @@ int main(const int ac, const char* const* const av) {
         ("feasibles,f", value<string>()->default_value(""), "The feasible file (a file where the feasibility information of the configuration is stored)")
         ("write-f,w", "Store info into a feasible file")
         ("read-f,r", "Read from feasible file (Skip D-reducibility check)")
+        ("warm-f", "Continue the D-reducibility check from the state stored in the binary (.bin) feasible file by an earlier -w run")
         ("without-d", "Output the feasible file without the D-reducibility check (For debugging purposes)")
-        ("rotate-f", "Rotate the coloring info for feasible info (For debugging purposes, not to be used for read-f option)");
+        ("rotate-f", "Rotate the coloring info for feasible info (For debugging purposes, not to be used for read-f option)")
+        ("prioritize,p", "Try the most promising contractions first within each contraction size")
+        ("goal-d", value<int>()->default_value(0), "Drive the D-reducibility check toward the colorings that contractions up to this size can extend, and stop as soon as one contraction succeeds (0: off)")
+        ("pipeline", "Compute the contractions and their extendable colorings on worker threads while the D-reducibility check runs")
+        ("threads,j", value<int>()->default_value(0), "Number of worker threads (0: number of hardware threads)")
+        ("cache-dir", value<string>()->default_value(""), "Directory to cache the extendable colorings of each contraction in (shared by all Kempe types)")
+        ("all-types", "Evaluate the dconf file under all four Kempe types (planar, apex, projective and toroidal) in one run")
+        ("symmetry", "Use the symmetries of the configuration that map the ring to itself to reduce the colorings updated in the D-reducibility check")
+        ("verdict-cache", value<string>()->default_value(""), "Directory to store the verdict of each configuration in, keyed by its canonical form (so relabeled, rotated or reflected copies reuse it)")
+        ("cert-dir", value<string>()->default_value(""), "Directory to write a certificate (<name>.cert: the Kempe type, the successful contraction and a hash of the feasible colorings) of each reducible configuration to")
+        ("verify-certs", "Instead of searching for contractions, verify the certificates in --cert-dir of the -i configurations (only the D-reducibility check and the recorded contraction)")
+        ("checkpoint-dir", value<string>()->default_value(""), "Directory to periodically save the state of the D- and C-reducibility checks of each configuration to (<name>.ckpt, removed when the check finishes)")
+        ("checkpoint-interval", value<double>()->default_value(600), "Seconds between two checkpoints")
+        ("resume", "Continue from the checkpoint in --checkpoint-dir if there is one")
+        ("time-budget", value<double>()->default_value(0), "Seconds each configuration may take before its check is stopped and reported as over budget with its partial progress (0: unlimited)")
+        ("mem-budget", value<int64_t>()->default_value(0), "MiB by which the resident memory of the process may grow during the check of a configuration before it is stopped and reported as over budget (0: unlimited)")
+        ("write-bundle", value<string>()->default_value(""), "Pack the configurations given by -i into this single bundle file (memory-mapped when passed to -i later) instead of evaluating them")
+        ("progress", value<double>()->default_value(0), "Print the progress of the current D-reducibility iteration or contraction size with its rate and ETA every this many seconds (0: off)")
+        ("status-file", value<string>()->default_value(""), "Keep the progress of the run in this JSON file for schedulers (updated every --progress seconds, or every 10 seconds)")
+        ("metrics", value<string>()->default_value(""), "Write the wall and CPU time of each phase, the work counters (total and per thread) and the peak memory to this JSON file")
+        ("in-memory-tables", "Do not write the Coloring and Kempe chain tables generated on demand to files")
+        ("log-dir", value<string>()->default_value("log"), "Directory to write the log of each configuration to when several configurations are evaluated")
+        ("queue-dir", value<string>()->default_value(""), "Directory shared by several processes evaluating the same configurations: each takes the ones not done or leased by another, and a rerun resumes the unfinished ones")
+        ("lease-timeout", value<int>()->default_value(60), "Seconds after which the lease of a process that stopped updating it is taken over")
+        ("shm-tables", value<string>()->default_value(""), "Name of a POSIX shared memory segment holding the Coloring and Kempe chain tables, created by the first process and mapped read-only by the others")
+        ("serve", value<string>()->default_value(""), "Run as a daemon listening on this Unix socket, keeping the tables loaded and evaluating the configurations sent by --connect on -j workers")
+        ("connect", value<string>()->default_value(""), "Send the -i file and the other options to the daemon listening on this Unix socket and print its log");
+    return description;
+}
+
+// 判定に関するオプションを読む (不正な組み合わせの場合は std::nullopt)
+optional<EvaluateOptions> ReadEvaluateOptions(const variables_map& vm) {
+    auto planar = vm.count("planar") > 0;
+    auto apex = vm.count("apex") > 0;
+    auto toroidal = vm.count("toroidal") > 0;
+    auto edgeSetString = vm["edge-set"].as<string>();
+    auto haltNum = vm["chalt"].as<int>();
+
+    EvaluateOptions options;
+    options.type = planar ? Planar : apex ? Apex : toroidal ? Toroidal : Projective;
+    options.haltType = haltNum == 0 ? HaltImmediately : haltNum == 1 ? HaltAfterSameSize : NoHalt;
+    options.minCont = vm["cmin"].as<int>();
+    options.maxCont = vm["cmax"].as<int>();
+    options.feasibleFile = vm["feasibles"].as<string>();
+    options.writeToFeasible = vm.count("write-f") > 0;
+    options.readFromFeasible = vm.count("read-f") > 0;
+    options.outputWithoutDReducibleCheck = vm.count("without-d") > 0;
+    options.rotateColoringOfFeasible = vm.count("rotate-f") > 0;
+    options.warmStartFromFeasible = vm.count("warm-f") > 0;
+    options.isAnnular = vm.count("annular") > 0;
+    options.prioritize = vm.count("prioritize") > 0;
+    options.goalContMax = vm["goal-d"].as<int>();
+    options.pipelined = vm.count("pipeline") > 0;
+    options.threadNum = vm["threads"].as<int>();
+    options.cacheDir = vm["cache-dir"].as<string>();
+    options.allTypes = vm.count("all-types") > 0;
+    options.useSymmetry = vm.count("symmetry") > 0;
+    options.verdictCacheDir = vm["verdict-cache"].as<string>();
+    options.certificateDir = vm["cert-dir"].as<string>();
+    options.verifyCertificates = vm.count("verify-certs") > 0;
+    options.checkpointDir = vm["checkpoint-dir"].as<string>();
+    options.checkpointInterval = vm["checkpoint-interval"].as<double>();
+    options.resume = vm.count("resume") > 0;
+    options.timeBudget = vm["time-budget"].as<double>();
+    options.memoryBudgetMb = vm["mem-budget"].as<int64_t>();
+    if (options.warmStartFromFeasible && !IsBinaryFeasibleFile(options.feasibleFile)) {
+        spdlog::error("--warm-f needs a binary feasible file (-f <file>.bin)");
+        return std::nullopt;
+    }
+    if (options.allTypes && (options.readFromFeasible || options.writeToFeasible || options.outputWithoutDReducibleCheck || options.warmStartFromFeasible || options.isAnnular)) {
+        spdlog::error("--all-types cannot be combined with feasible files or annular configurations");
+        return std::nullopt;
+    }
+    // goal-directed な check は 1 つの contraction が成功した時点で停止する
+    if (options.goalContMax > 0 && options.haltType != HaltImmediately) {
+        spdlog::error("--goal-d stops at the first successful contraction and needs -h 0");
+        return std::nullopt;
+    }
+    if (options.allTypes && (options.pipelined || options.goalContMax > 0)) {
+        spdlog::error("--all-types cannot be combined with --pipeline or --goal-d");
+        return std::nullopt;
+    }
+    if (options.verifyCertificates && (options.certificateDir.empty() || options.isAnnular)) {
+        spdlog::error("--verify-certs needs --cert-dir and does not support annular configurations");
+        return std::nullopt;
+    }
+    if (options.resume && options.checkpointDir.empty()) {
+        spdlog::error("--resume needs --checkpoint-dir");
+        return std::nullopt;
+    }
+    if (!options.checkpointDir.empty() && (options.allTypes || options.pipelined || options.goalContMax > 0 || options.readFromFeasible || options.outputWithoutDReducibleCheck || options.warmStartFromFeasible)) {
+        spdlog::error("--checkpoint-dir cannot be combined with --all-types, --pipeline, --goal-d, -r, --without-d or --warm-f");
+        return std::nullopt;
+    }
+    if (options.threadNum <= 0) {
+        options.threadNum = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    options.hasEdgeSet = edgeSetString.size() > 0;
+    if (options.hasEdgeSet) {
+        boost::char_separator<char> sep("+,");
+        boost::tokenizer<boost::char_separator<char>> tokens(edgeSetString, sep);
+        for (std::string s : tokens) {
+            options.edgeSet.push_back(std::stoi(s));
+        }
+    }
+    return options;
+}
+
+int main(const int ac, const char* const* const av) {
+    auto description = MakeOptionsDescription();
 
     variables_map vm;
     store(parse_command_line(ac, av, description), vm);
@@ -50,6 +168,15 @@ int main(const int ac, const char* const* const av) {
             spdlog::set_level(spdlog::level::trace);
         }
     }
+    if (vm.count("in-memory-tables")) {
+        TableProvider::Instance().SetPersist(false);
+    }
+    auto metricsFile = vm["metrics"].as<string>();
+    if (!metricsFile.empty()) {
+        Metrics::Enable();
+    }
+    bool failed = false;
+    bool overBudget = false;
     if (vm.count("kempe")) {
         auto k = vm["kempe"].as<int>();
         if (k > 0) {
@@ -64,50 +191,215 @@ int main(const int ac, const char* const* const av) {
             GenerateColors(c);
         }
     }
+    auto serveSocket = vm["serve"].as<string>();
+    if (!serveSocket.empty()) {
+        auto threadNum = vm["threads"].as<int>();
+        int workerNum = threadNum > 0 ? threadNum : DefaultThreadNum();
+        try {
+            ServeDaemon(serveSocket, workerNum, [&](const vector<string>& args) -> optional<EvaluateOptions> {
+                variables_map requestVm;
+                store(command_line_parser(args).options(description).run(), requestVm);
+                notify(requestVm);
+                auto options = ReadEvaluateOptions(requestVm);
+                // メモリの予算はプロセス全体の常駐メモリで測るので、他のリクエストと並行して判定すると、そのメモリまで数えてしまう
+                if (options && options->memoryBudgetMb > 0 && workerNum > 1) {
+                    spdlog::error("--mem-budget needs a daemon with a single worker (--serve with -j 1)");
+                    return std::nullopt;
+                }
+                // ワーカーが既に並列に動いているので、リクエストごとのスレッドは明示された場合だけ使う
+                if (options && requestVm["threads"].as<int>() <= 0) options->threadNum = 1;
+                return options;
+            });
+        }
+        catch (const std::exception& e) {
+            spdlog::critical("The program threw an error: {}", e.what());
+            return 1;
+        }
+    }
     if (vm.count("input")) {
         auto fileName = vm["input"].as<string>();
         auto duality = vm.count("duality") > 0;
-        auto planar = vm.count("planar") > 0;
-        auto apex = vm.count("apex") > 0;
-        auto toroidal = vm.count("toroidal") > 0;
-        auto annular = vm.count("annular") > 0;
-        auto edgeSetString = vm["edge-set"].as<string>();
-        auto haltNum = vm["chalt"].as<int>();
-        auto haltType = haltNum == 0 ? HaltImmediately : haltNum == 1 ? HaltAfterSameSize : NoHalt;
-        auto contMin = vm["cmin"].as<int>();
-        auto contMax = vm["cmax"].as<int>();
-        auto feasibleFile = vm["feasibles"].as<string>();
-        auto writeToFeasible = vm.count("write-f") > 0;
-        auto readFromFeasible = vm.count("read-f") > 0;
-        auto withoutD = vm.count("without-d") > 0;
-        auto rotateFeasible = vm.count("rotate-f") > 0;
-
-        bool hasEdgeSet = edgeSetString.size() > 0;
-        vector<int> edgeSet;
-        if (hasEdgeSet) {
-            boost::char_separator<char> sep("+,");
-            boost::tokenizer<boost::char_separator<char>> tokens(edgeSetString, sep);
-            for (std::string s : tokens) {
-                edgeSet.push_back(std::stoi(s));
+        auto connectSocket = vm["connect"].as<string>();
+        if (!connectSocket.empty()) {
+            // -i (ファイルの中身を送る) と --connect 以外の引数をそのまま送る
+            vector<string> args;
+            for (int i = 1; i < ac; i++) {
+                string arg = av[i];
+                if (arg == "--connect" || arg == "-i" || arg == "--input") {
+                    i++;
+                    continue;
+                }
+                if (arg.starts_with("--connect=") || arg.starts_with("--input=") || (arg.starts_with("-i") && arg.size() > 2)) continue;
+                args.push_back(arg);
+            }
+            return RequestDaemon(connectSocket, args, fileName, cout);
+        }
+        auto maybeOptions = ReadEvaluateOptions(vm);
+        if (!maybeOptions) {
+            return 1;
+        }
+        auto options = *maybeOptions;
+        auto extension = options.isAnnular ? ".nconf" : ".dconf";
+        auto fromConf = vm.count("from-conf") > 0;
+        auto isStream = fileName == "-";
+        if ((duality || fromConf) && options.isAnnular) {
+            spdlog::error("-d and --from-conf do not support annular configurations");
+            return 1;
+        }
+        auto bundleName = vm["write-bundle"].as<string>();
+        if (!bundleName.empty()) {
+            try {
+                if (fromConf) {
+                    WriteConfBundleOfConfs(bundleName, isStream ? vector<string>{"-"} : ExpandInputs(fileName, ".conf"));
+                }
+                else {
+                    WriteConfBundle(bundleName, ExpandInputs(fileName, extension), options.isAnnular);
+                }
+            }
+            catch (const std::exception& e) {
+                spdlog::critical("The program threw an error: {}", e.what());
+                return 1;
             }
+            return 0;
         }
-        if (duality) {
+        if (duality && (isStream || IsBatchInput(fileName))) {
+            auto dconfDir = vm["dconf-dir"].as<string>();
+            if (dconfDir.empty()) {
+                spdlog::error("-d with several conf files needs --dconf-dir");
+                return 1;
+            }
+            try {
+                ConvertConfs(isStream ? vector<string>{"-"} : ExpandInputs(fileName, ".conf"), dconfDir);
+            }
+            catch (const std::exception& e) {
+                spdlog::critical("The program threw an error: {}", e.what());
+                return 1;
+            }
+            return 0;
+        }
+        // 判定する configuration の一覧 (--from-conf の場合は .conf から変換したもの)
+        auto batchItems = [&] {
+            if (fromConf) return BatchItemsOfConfs(isStream ? vector<string>{"-"} : ExpandInputs(fileName, ".conf"));
+            return BatchItemsOf(ExpandInputs(fileName, extension), options.isAnnular);
+        };
+        vector<BatchItem> items;
+        if (fromConf) {
+            try {
+                items = batchItems();
+            }
+            catch (const std::exception& e) {
+                spdlog::critical("The program threw an error: {}", e.what());
+                return 1;
+            }
+        }
+        auto shmName = vm["shm-tables"].as<string>();
+        if (!shmName.empty() && !duality) {
+            try {
+                AttachSharedTables(shmName, fromConf ? items : batchItems(), options);
+            }
+            catch (const std::exception& e) {
+                spdlog::critical("The program threw an error: {}", e.what());
+                return 1;
+            }
+        }
+        // 途中経過は 1 つの configuration を判定する場合だけ表示する (複数の場合は終わった configuration ごとに 1 行出る)
+        auto progressInterval = vm["progress"].as<double>();
+        auto statusFile = vm["status-file"].as<string>();
+        bool isSingle = fromConf ? items.size() == 1 && !IsBatchInput(fileName) : !IsBatchInput(fileName) && !duality;
+        std::optional<ProgressReporter> reporter;
+        if (progressInterval > 0 || !statusFile.empty()) {
+            if (isSingle) {
+                reporter.emplace(progressInterval > 0 ? progressInterval : 10.0, progressInterval > 0, statusFile);
+            }
+            else {
+                spdlog::warn("--progress and --status-file are only used when a single configuration is evaluated");
+            }
+        }
+        if (fromConf && items.size() == 1 && !IsBatchInput(fileName)) {
+            try {
+                options.confName = items[0].name;
+                overBudget = IsOverBudget(items[0].evaluate(options));
+            }
+            catch (const std::exception& e) {
+                spdlog::critical("The program threw an error: {}", e.what());
+                spdlog::critical("Terminating.");
+                failed = true;
+            }
+        }
+        else if (fromConf || IsBatchInput(fileName)) {
+            if (!fromConf) {
+                try {
+                    items = batchItems();
+                }
+                catch (const std::exception& e) {
+                    spdlog::critical("The program threw an error: {}", e.what());
+                    return 1;
+                }
+            }
+            if (items.empty()) {
+                spdlog::error("No configurations found for {}", fileName);
+                return 1;
+            }
+            // 名前が重複すると、ログや queue の結果などを取り違える
+            if (auto duplicates = DuplicateNames(items); !duplicates.empty()) {
+                for (auto& [first, second] : duplicates) {
+                    spdlog::error("{} and {} have the same name", first, second);
+                }
+                spdlog::error("Configurations evaluated together must have distinct file names (without the extension)");
+                return 1;
+            }
+            // メモリの予算はプロセス全体の常駐メモリで測るので、並行して判定している他の configuration のメモリまで数えてしまう
+            // (queue では予算切れの印が残り、同じ予算ではやり直されない)
+            if (options.memoryBudgetMb > 0 && options.threadNum > 1 && items.size() > 1) {
+                spdlog::error("--mem-budget cannot be used when several configurations are evaluated on more than one thread (use -j 1)");
+                return 1;
+            }
+            // すべての configuration が同じ -f のファイルを読み書きすることになるので、feasible file は使えない
+            if (options.readFromFeasible || options.writeToFeasible || options.outputWithoutDReducibleCheck || options.rotateColoringOfFeasible || options.warmStartFromFeasible) {
+                spdlog::error("-r, -w, --without-d, --rotate-f and --warm-f cannot be used when several configurations are evaluated");
+                return 1;
+            }
+            auto queueDir = vm["queue-dir"].as<string>();
+            BatchSummary summary;
+            if (queueDir.empty()) {
+                summary = EvaluateBatch(items, options, vm["log-dir"].as<string>());
+            }
+            else {
+                JobQueue queue(queueDir, vm["lease-timeout"].as<int>());
+                summary = EvaluateBatch(items, options, queueDir, &queue);
+            }
+            failed = summary.failed > 0;
+            overBudget = summary.overBudget > 0;
+        }
+        else if (duality) {
             OutputDuality(fileName, cout);
         }
         else {
             try {
-                if (annular) {
-                    EvaluateConf<AnnularCubicConf>(fileName, planar ? Planar : apex ? Apex : toroidal ? Toroidal : Projective, haltType, contMin, contMax, feasibleFile, readFromFeasible, writeToFeasible, rotateFeasible, withoutD, hasEdgeSet, edgeSet, annular);
+                options.confName = std::filesystem::path(fileName).stem().string();
+                if (options.isAnnular) {
+                    overBudget = IsOverBudget(EvaluateConf<AnnularCubicConf>(fileName, options));
                 }
                 else {
-                    EvaluateConf<CubicConf>(fileName, planar ? Planar : apex ? Apex : toroidal ? Toroidal : Projective, haltType, contMin, contMax, feasibleFile, readFromFeasible, writeToFeasible, rotateFeasible, withoutD, hasEdgeSet, edgeSet, annular);
+                    overBudget = IsOverBudget(EvaluateConf<CubicConf>(fileName, options));
                 }
             }
             catch (const std::exception& e) {
                 spdlog::critical("The program threw an error: {}", e.what());
                 spdlog::critical("Terminating.");
+                failed = true;
             }
         }
     }
-    return 0;
+    if (!metricsFile.empty()) {
+        try {
+            Metrics::Write(metricsFile);
+        }
+        catch (const std::exception& e) {
+            spdlog::critical("The program threw an error: {}", e.what());
+            return 1;
+        }
+    }
+    if (failed) return 1;
+    return overBudget ? overBudgetExitCode : 0;
 }
\ No newline at end of file
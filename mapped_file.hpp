@@ -0,0 +1,60 @@
+#pragma once
+#include <string>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+
+// 読み込み専用で mmap したファイル
+class MappedFile {
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    void Map(int fd, const std::string& name) {
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            throw std::runtime_error("Error reading " + name);
+        }
+        size_ = st.st_size;
+        if (size_ > 0) {
+            void* p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) {
+                spdlog::critical("Error: Failed to map {}", name);
+                throw std::runtime_error("Error mapping " + name);
+            }
+            data_ = static_cast<const char*>(p);
+        }
+    }
+public:
+    explicit MappedFile(const std::string& fileName) {
+        int fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) {
+            spdlog::critical("Error: Failed to open {}", fileName);
+            throw std::runtime_error("Error opening " + fileName);
+        }
+        try {
+            Map(fd, fileName);
+        }
+        catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+    }
+    // 開いているファイル (shm_open したものなど) を読み込み専用で mmap する (fd は閉じない)
+    MappedFile(int fd, const std::string& name) {
+        Map(fd, name);
+    }
+    ~MappedFile() {
+        if (data_) ::munmap(const_cast<char*>(data_), size_);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    const char* data() const {
+        return data_;
+    }
+    size_t size() const {
+        return size_;
+    }
+};
@@ -0,0 +1,153 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+#include <ctime>
+#include <sys/resource.h>
+#include <spdlog/spdlog.h>
+#include <fmt/core.h>
+#include <fmt/ostream.h>
+
+using std::string;
+using std::vector;
+
+// --metrics で出力する計測値
+// 区間 (phase) ごとの経過時間・CPU 時間と、スレッドごとのカウンタを集める
+// 無効な場合、カウンタの加算と区間の計測は全体のフラグを 1 回見るだけで何もしない
+enum MetricCounter {
+    DfsNodes, // color_dfs で訪れた辺
+    KempePatternsTested, // OneReduction で試した Kempe chain
+    ColoringLookups, // Kempe change で得た Coloring の番号の検索
+    ContractionsRejected, // 拡張可能な infeasible な Coloring があった contraction
+    MetricCounterNum
+};
+
+const char* MetricCounterName(MetricCounter counter) {
+    switch (counter) {
+        case DfsNodes: return "dfs_nodes";
+        case KempePatternsTested: return "kempe_patterns_tested";
+        case ColoringLookups: return "coloring_lookups";
+        case ContractionsRejected: return "contractions_rejected";
+        default: return "unknown";
+    }
+}
+
+class Metrics {
+    struct ThreadCounters {
+        uint64_t values[MetricCounterNum] = {};
+    };
+    struct Phase {
+        string name;
+        int count = 0;
+        double wallSeconds = 0;
+        double cpuSeconds = 0;
+    };
+    static inline bool enabled = false;
+    static inline std::mutex mtx;
+    static inline vector<std::shared_ptr<ThreadCounters>> threads; // 終了したスレッドの分も残す
+    static inline vector<Phase> phases; // 最初に現れた順
+    static inline thread_local ThreadCounters* local = nullptr;
+    static inline std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    static ThreadCounters& Local() {
+        if (!local) {
+            auto counters = std::make_shared<ThreadCounters>();
+            std::lock_guard lock(mtx);
+            threads.push_back(counters);
+            local = counters.get();
+        }
+        return *local;
+    }
+public:
+    static void Enable() {
+        enabled = true;
+        startTime = std::chrono::steady_clock::now();
+    }
+    static bool Enabled() {
+        return enabled;
+    }
+    static void Add(MetricCounter counter, uint64_t value = 1) {
+        if (enabled) Local().values[counter] += value;
+    }
+    static double CpuSeconds() {
+        timespec ts;
+        ::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+    static void RecordPhase(const string& name, double wallSeconds, double cpuSeconds) {
+        std::lock_guard lock(mtx);
+        for (auto& phase : phases) {
+            if (phase.name == name) {
+                phase.count++;
+                phase.wallSeconds += wallSeconds;
+                phase.cpuSeconds += cpuSeconds;
+                return;
+            }
+        }
+        phases.push_back({name, 1, wallSeconds, cpuSeconds});
+    }
+    // 計測値を JSON として出力する
+    // 区間の CPU 時間はその間のプロセス全体のもの (並行して動いている他のスレッドの分も含む)
+    static void Write(const string& fileName) {
+        std::ofstream ofs(fileName);
+        if (!ofs) {
+            spdlog::critical("Error: Failed to open {}", fileName);
+            throw std::runtime_error("Error opening " + fileName);
+        }
+        rusage usage;
+        ::getrusage(RUSAGE_SELF, &usage);
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        std::lock_guard lock(mtx);
+        auto countersOf = [](const ThreadCounters& counters) {
+            string res;
+            for (int c = 0; c < MetricCounterNum; c++) {
+                res += fmt::format("{}\"{}\": {}", c ? ", " : "", MetricCounterName(MetricCounter(c)), counters.values[c]);
+            }
+            return res;
+        };
+        ThreadCounters total;
+        for (auto& counters : threads) {
+            for (int c = 0; c < MetricCounterNum; c++) total.values[c] += counters->values[c];
+        }
+        fmt::print(ofs, "{{\n  \"wall_seconds\": {:.6f},\n  \"cpu_seconds\": {:.6f},\n  \"peak_rss_kb\": {},\n", wall, CpuSeconds(), usage.ru_maxrss);
+        ofs << "  \"phases\": [\n";
+        for (size_t i = 0; i < phases.size(); i++) {
+            auto& phase = phases[i];
+            fmt::print(ofs, "    {{\"name\": \"{}\", \"count\": {}, \"wall_seconds\": {:.6f}, \"cpu_seconds\": {:.6f}}}{}\n",
+                phase.name, phase.count, phase.wallSeconds, phase.cpuSeconds, i + 1 < phases.size() ? "," : "");
+        }
+        fmt::print(ofs, "  ],\n  \"counters\": {{{}}},\n  \"threads\": [\n", countersOf(total));
+        for (size_t i = 0; i < threads.size(); i++) {
+            fmt::print(ofs, "    {{{}}}{}\n", countersOf(*threads[i]), i + 1 < threads.size() ? "," : "");
+        }
+        ofs << "  ]\n}\n";
+        spdlog::info("Wrote metrics to {}", fileName);
+    }
+};
+
+// スコープの間を区間 name として計測する (Metrics が無効なら何もしない)
+class PhaseTimer {
+    string name;
+    bool active;
+    std::chrono::steady_clock::time_point wallStart;
+    double cpuStart = 0;
+public:
+    explicit PhaseTimer(const string& name) : active(Metrics::Enabled()) {
+        if (!active) return;
+        this->name = name;
+        wallStart = std::chrono::steady_clock::now();
+        cpuStart = Metrics::CpuSeconds();
+    }
+    ~PhaseTimer() {
+        if (!active) return;
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+        Metrics::RecordPhase(name, wall, Metrics::CpuSeconds() - cpuStart);
+    }
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+};
@@ -0,0 +1,179 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+#include <fmt/core.h>
+#include <fmt/ostream.h>
+
+using std::string;
+
+// 長い判定の途中経過
+// 判定する側は段階 (D-reducibility check の 1 回の update、C-reducibility check の 1 つの大きさの contraction) の開始と、
+// その段階で処理した個数だけを atomic な変数に書き、表示は ProgressReporter のスレッドが一定間隔で読んで行う
+// 無効な場合、Advance などは全体のフラグを 1 回見るだけで何もしない
+class Progress {
+    static inline std::atomic<bool> enabled = false;
+    static inline std::mutex mtx;
+    static inline string stage; // 段階の名前 (mtx で保護)
+    static inline string unit; // 処理する対象の単位 (mtx で保護)
+    static inline std::atomic<int64_t> stageStart = 0; // 段階を始めた時刻 (steady_clock のナノ秒)
+    static inline std::atomic<int64_t> done = 0;
+    static inline std::atomic<int64_t> total = 0; // 0 なら不明
+    static inline std::atomic<int64_t> feasibleCount = -1; // D-reducibility check の feasible な Coloring の個数 (-1 なら不明)
+    static inline std::atomic<int64_t> colorNum = 0;
+    static inline std::atomic<int64_t> contDone = -1; // C-reducibility check で試し終えた contraction の個数 (-1 なら不明)
+    static inline std::atomic<int64_t> contTotal = 0;
+
+    static int64_t Now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+public:
+    // 段階ごとの値の組 (ProgressReporter が読み出す)
+    struct Snapshot {
+        string stage;
+        string unit;
+        double elapsedSeconds = 0; // 段階を始めてからの時間
+        int64_t done = 0;
+        int64_t total = 0;
+        int64_t feasibleCount = -1;
+        int64_t colorNum = 0;
+        int64_t contDone = -1;
+        int64_t contTotal = 0;
+    };
+    static void Enable() {
+        enabled = true;
+    }
+    static bool Enabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+    // 段階 name を始める (total 個の unit を処理する、0 なら個数は不明)
+    static void Start(const string& name, int64_t total, const string& unit) {
+        if (!Enabled()) return;
+        std::lock_guard lock(mtx);
+        stage = name;
+        Progress::unit = unit;
+        Progress::total = total;
+        done = 0;
+        stageStart = Now();
+    }
+    static void Advance(int64_t n = 1) {
+        if (Enabled()) done.fetch_add(n, std::memory_order_relaxed);
+    }
+    static void SetFeasible(int64_t feasible, int64_t colorings) {
+        if (!Enabled()) return;
+        feasibleCount = feasible;
+        colorNum = colorings;
+    }
+    static void SetContractions(int64_t contractionsDone, int64_t contractions) {
+        if (!Enabled()) return;
+        contDone = contractionsDone;
+        contTotal = contractions;
+    }
+    static Snapshot Sample() {
+        Snapshot snapshot;
+        {
+            std::lock_guard lock(mtx);
+            snapshot.stage = stage;
+            snapshot.unit = unit;
+        }
+        snapshot.elapsedSeconds = (Now() - stageStart) * 1e-9;
+        snapshot.done = done;
+        snapshot.total = total;
+        snapshot.feasibleCount = feasibleCount;
+        snapshot.colorNum = colorNum;
+        snapshot.contDone = contDone;
+        snapshot.contTotal = contTotal;
+        return snapshot;
+    }
+};
+
+// 秒数を 1h02m03s のように表す
+string FormatDuration(double seconds) {
+    if (!std::isfinite(seconds) || seconds < 0) return "?";
+    auto s = (int64_t)std::llround(seconds);
+    if (s >= 3600) return fmt::format("{}h{:02}m{:02}s", s / 3600, s / 60 % 60, s % 60);
+    if (s >= 60) return fmt::format("{}m{:02}s", s / 60, s % 60);
+    return fmt::format("{}s", s);
+}
+
+// interval 秒ごとに Progress を読み、(writeLog なら) 処理の速さと残り時間の見積もりをログに出す
+// statusFile が空でなければ、同じ内容を JSON で statusFile に (一時ファイルからの rename で) 書き出す
+// 破棄されるときに最後の状態を "finished": true として書く
+class ProgressReporter {
+    double interval;
+    bool writeLog;
+    string statusFile;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopped = false;
+    std::thread thread;
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    void Report(bool finished) {
+        auto snapshot = Progress::Sample();
+        double rate = snapshot.elapsedSeconds > 0 ? snapshot.done / snapshot.elapsedSeconds : 0;
+        double eta = snapshot.total > 0 && rate > 0 ? (snapshot.total - snapshot.done) / rate : -1;
+        if (writeLog && !finished && !snapshot.stage.empty()) {
+            string line = snapshot.total > 0
+                ? fmt::format("[progress] {}: {} / {} {} ({:.1f}%), {:.1f} {}/s, ETA {}", snapshot.stage, snapshot.done, snapshot.total, snapshot.unit,
+                    100.0 * snapshot.done / snapshot.total, rate, snapshot.unit, FormatDuration(eta))
+                : fmt::format("[progress] {}: running for {}", snapshot.stage, FormatDuration(snapshot.elapsedSeconds));
+            if (snapshot.feasibleCount >= 0) {
+                line += fmt::format(", feasible {} / {}", snapshot.feasibleCount, snapshot.colorNum);
+            }
+            if (snapshot.contDone >= 0) {
+                line += fmt::format(", contractions {} / {}", snapshot.contDone, snapshot.contTotal);
+            }
+            spdlog::info(line);
+        }
+        if (statusFile.empty()) return;
+        auto temporary = statusFile + ".tmp";
+        {
+            std::ofstream ofs(temporary);
+            if (!ofs) {
+                spdlog::error("Failed to write the status file {}", temporary);
+                return;
+            }
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+            fmt::print(ofs, "{{\n  \"finished\": {},\n  \"elapsed_seconds\": {:.3f},\n  \"stage\": \"{}\",\n  \"unit\": \"{}\",\n", finished, elapsed, snapshot.stage, snapshot.unit);
+            fmt::print(ofs, "  \"done\": {},\n  \"total\": {},\n  \"rate\": {:.3f},\n  \"eta_seconds\": {:.3f},\n", snapshot.done, snapshot.total, rate, eta);
+            fmt::print(ofs, "  \"feasible\": {},\n  \"colorings\": {},\n  \"contractions_done\": {},\n  \"contractions_total\": {}\n}}\n",
+                snapshot.feasibleCount, snapshot.colorNum, snapshot.contDone, snapshot.contTotal);
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, statusFile, error);
+        if (error) spdlog::error("Failed to write the status file {}: {}", statusFile, error.message());
+    }
+public:
+    ProgressReporter(double interval, bool writeLog, const string& statusFile) : interval(interval), writeLog(writeLog), statusFile(statusFile) {
+        Progress::Enable();
+        thread = std::thread([this] {
+            std::unique_lock lock(mtx);
+            while (!cv.wait_for(lock, std::chrono::duration<double>(this->interval), [&] { return stopped; })) {
+                lock.unlock();
+                Report(false);
+                lock.lock();
+            }
+        });
+    }
+    ~ProgressReporter() {
+        {
+            std::lock_guard lock(mtx);
+            stopped = true;
+        }
+        cv.notify_all();
+        thread.join();
+        Report(true);
+    }
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+};
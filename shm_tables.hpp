@@ -0,0 +1,174 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <functional>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <spdlog/spdlog.h>
+#include "kempe_store.hpp"
+#include "mapped_file.hpp"
+#include "coloring_table.hpp"
+
+using std::string;
+using std::vector;
+
+// Coloring と Kempe chain の表をまとめて POSIX 共有メモリ (/dev/shm/<name>) に置いたもの
+// 同じマシン上の複数のプロセスが、表を読み込み・生成し直さずに (読み込み専用で) 共有する
+// 中身の形式は kempes/<種類>.bin と同様に、ヘッダ、索引、固定長の行を並べたもので、位置は全てセグメント先頭からのオフセットで表す
+// (各表の先頭は 8 バイト境界にそろえる)
+struct TableSegmentHeader {
+    char magic[8];
+    uint64_t size; // セグメント全体の大きさ
+    uint32_t entryNum;
+    uint32_t ready; // 作成したプロセスが書き込みを終えると 1 になる
+};
+struct TableSegmentEntry {
+    uint32_t kind; // KempeType, annularKempeStoreType または segmentColoringKind
+    int32_t left;
+    int32_t right;
+    uint32_t width;
+    uint64_t count;
+    uint64_t offset;
+};
+constexpr char tableSegmentMagic[8] = {'T', 'A', 'B', 'L', 'E', 'S', '0', '1'};
+constexpr uint32_t segmentColoringKind = 5; // (left, right) = (リングの大きさ, 0) の Coloring の列
+constexpr uint32_t segmentColoringOrderKind = 6; // (left, right) = (リングの大きさ, 0) の ColoringTable の索引 (int32 を 1 行とする)
+
+// セグメントに入れる 1 つの表 (長さの等しい行の列)
+struct SegmentTable {
+    uint32_t kind;
+    int left, right;
+    vector<string> rows;
+};
+
+class TableSegment {
+    std::shared_ptr<MappedFile> file;
+    const TableSegmentHeader* Header() const {
+        return reinterpret_cast<const TableSegmentHeader*>(file->data());
+    }
+    bool IsReady() const {
+        auto& ready = const_cast<uint32_t&>(Header()->ready);
+        return std::atomic_ref<uint32_t>(ready).load(std::memory_order_acquire) == 1;
+    }
+    // 表の大きさを計算し、書き込み可能な共有メモリに書き込む
+    static void Write(int fd, const vector<SegmentTable>& tables) {
+        uint64_t size = sizeof(TableSegmentHeader) + sizeof(TableSegmentEntry) * tables.size();
+        vector<TableSegmentEntry> entries;
+        for (auto& table : tables) {
+            TableSegmentEntry entry = {};
+            entry.kind = table.kind;
+            entry.left = table.left;
+            entry.right = table.right;
+            entry.width = table.rows.empty() ? 0 : table.rows[0].size();
+            entry.count = table.rows.size();
+            size = (size + 7) / 8 * 8;
+            entry.offset = size;
+            size += entry.width * entry.count;
+            entries.push_back(entry);
+        }
+        if (::ftruncate(fd, size) != 0) {
+            throw std::runtime_error("Failed to resize the shared memory segment");
+        }
+        void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error("Failed to map the shared memory segment");
+        }
+        char* data = static_cast<char*>(p);
+        auto header = reinterpret_cast<TableSegmentHeader*>(data);
+        std::memcpy(header->magic, tableSegmentMagic, sizeof(header->magic));
+        header->size = size;
+        header->entryNum = entries.size();
+        std::memcpy(data + sizeof(TableSegmentHeader), entries.data(), sizeof(TableSegmentEntry) * entries.size());
+        for (size_t i = 0; i < tables.size(); i++) {
+            char* row = data + entries[i].offset;
+            for (auto& s : tables[i].rows) {
+                std::memcpy(row, s.data(), s.size());
+                row += s.size();
+            }
+        }
+        std::atomic_ref<uint32_t>(header->ready).store(1, std::memory_order_release);
+        ::munmap(p, size);
+    }
+    explicit TableSegment(std::shared_ptr<MappedFile> file) : file(std::move(file)) {}
+public:
+    // 共有メモリ name がなければ build() の表で作り、あれば (作成中なら終わるのを待って) 読み込み専用で開く
+    static std::shared_ptr<TableSegment> CreateOrAttach(const string& name, const std::function<vector<SegmentTable>()>& build, int waitSeconds = 600) {
+        auto shmName = "/" + name;
+        int fd = ::shm_open(shmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd >= 0) {
+            spdlog::info("Creating shared memory segment {}", shmName);
+            try {
+                Write(fd, build());
+            }
+            catch (...) {
+                ::close(fd);
+                ::shm_unlink(shmName.c_str());
+                throw;
+            }
+            ::close(fd);
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(waitSeconds);
+        while (true) {
+            fd = ::shm_open(shmName.c_str(), O_RDONLY, 0);
+            if (fd < 0) {
+                spdlog::critical("Error: Failed to open shared memory segment {}", shmName);
+                throw std::runtime_error("Error opening " + shmName);
+            }
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(TableSegmentHeader)) {
+                auto segment = std::shared_ptr<TableSegment>(new TableSegment(std::make_shared<MappedFile>(fd, shmName)));
+                ::close(fd);
+                if (segment->IsReady()) {
+                    if (std::memcmp(segment->Header()->magic, tableSegmentMagic, sizeof(tableSegmentMagic)) != 0 || segment->Header()->size != segment->file->size()) {
+                        spdlog::critical("Error: {} is not a valid table segment", shmName);
+                        throw std::runtime_error("Invalid table segment " + shmName);
+                    }
+                    spdlog::info("Attached shared memory segment {} ({} tables)", shmName, segment->Header()->entryNum);
+                    return segment;
+                }
+            }
+            else {
+                ::close(fd);
+            }
+            if (std::chrono::steady_clock::now() > deadline) {
+                spdlog::critical("Error: Shared memory segment {} was not completed (remove /dev/shm{} if its creator has stopped)", shmName, shmName);
+                throw std::runtime_error("Timed out waiting for " + shmName);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    // (kind, left, right) の表を (コピーせずに) 返す
+    std::optional<KempeTable> Find(uint32_t kind, int left, int right) const {
+        auto entries = reinterpret_cast<const TableSegmentEntry*>(file->data() + sizeof(TableSegmentHeader));
+        for (uint32_t i = 0; i < Header()->entryNum; i++) {
+            auto& entry = entries[i];
+            if (entry.kind == kind && entry.left == left && entry.right == right) {
+                return KempeTable(file, file->data() + entry.offset, entry.count, entry.width);
+            }
+        }
+        return std::nullopt;
+    }
+    // リングの大きさ ringSize の Coloring の列を (コピーせずに) 返す
+    // 索引がセグメントにない場合 (古い形式のセグメント) は、このプロセスで作る
+    std::optional<ColoringTable> FindColorings(int ringSize) const {
+        auto rows = Find(segmentColoringKind, ringSize, 0);
+        if (!rows) return std::nullopt;
+        auto data = rows->size() == 0 ? nullptr : (*rows)[0].data();
+        auto order = Find(segmentColoringOrderKind, ringSize, 0);
+        if (order && order->size() == rows->size() && order->Width() == sizeof(int32_t)) {
+            auto orderData = order->size() == 0 ? nullptr : reinterpret_cast<const int32_t*>((*order)[0].data());
+            return ColoringTable(file, data, orderData, rows->size(), rows->Width());
+        }
+        return ColoringTable::WithOrder(file, data, rows->size(), rows->Width());
+    }
+};
@@ -0,0 +1,166 @@
+#pragma once
+#include "generate_colors.hpp"
+#include "generate_kempes.hpp"
+#include "shm_tables.hpp"
+#include "dihedral_action.hpp"
+#include "metrics.hpp"
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <filesystem>
+#include <spdlog/spdlog.h>
+
+// Coloring と Kempe chain の表を、必要になったときに大きさ・種類ごとに用意してプロセス内で使い回す
+// ファイル (-c, -k で作ったもの) があればそれを読み込み、なければその場で生成する
+// 生成したものは、persist が true ならファイルにも書き出して次回以降に使う
+// 共有メモリのセグメントが設定されていれば、そこにある表を最初に使う
+class TableProvider {
+    std::mutex mtx;
+    bool persist = true;
+    std::shared_ptr<const TableSegment> segment;
+    std::map<int, ColoringTable> colorings;
+    std::map<std::tuple<int, int, int>, KempeTable> kempes; // (種類, left, right) -> Kempe chain の表
+    std::map<int, DihedralAction> actions;
+    TableProvider() = default;
+public:
+    static TableProvider& Instance() {
+        static TableProvider provider;
+        return provider;
+    }
+    void SetPersist(bool value) {
+        std::lock_guard lock(mtx);
+        persist = value;
+    }
+    void AttachSegment(std::shared_ptr<const TableSegment> value) {
+        std::lock_guard lock(mtx);
+        segment = std::move(value);
+    }
+    // リングの大きさ size の Coloring の列 (ファイルの並び順)
+    // 共有メモリのセグメントにあれば、その行と索引を (コピーせずに) 使う
+    const ColoringTable& RingColorings(int size) {
+        std::lock_guard lock(mtx);
+        auto it = colorings.find(size);
+        if (it != colorings.end()) return it->second;
+        PhaseTimer phase("table load");
+        if (auto table = segment ? segment->FindColorings(size) : std::nullopt) {
+            return colorings[size] = *table;
+        }
+        if (std::filesystem::exists(ColorFileName(size))) {
+            return colorings[size] = ColoringTable::FromColorings(LoadColorFile(size));
+        }
+        spdlog::info("Color file for ring size {} not found, generating it", size);
+        auto res = Coloring::GetValidColorings(size);
+        if (persist) WriteColorFile(size, res);
+        return colorings[size] = ColoringTable::FromColorings(res);
+    }
+    // リングの大きさ size の Coloring の番号への、リングの回転・反転の作用 (Coloring の表と同じく、ファイルがなければ生成する)
+    const DihedralAction& RingAction(int size) {
+        auto& ringColorings = RingColorings(size);
+        std::lock_guard lock(mtx);
+        auto it = actions.find(size);
+        if (it != actions.end()) return it->second;
+        auto coloringHash = HashColorings(ringColorings);
+        auto fileName = DihedralFileName(size);
+        if (auto action = LoadDihedralFile(fileName, size, ringColorings.size(), coloringHash)) {
+            return actions[size] = *action;
+        }
+        spdlog::info("Dihedral action file for ring size {} not found, generating it", size);
+        auto action = DihedralAction::Compute(size, ringColorings);
+        if (persist) WriteDihedralFile(fileName, action, coloringHash);
+        return actions[size] = std::move(action);
+    }
+    // Kempe pair が size 個の、種類 type の Kempe chain
+    const KempeTable& Kempes(int size, KempeType type) {
+        std::lock_guard lock(mtx);
+        auto key = std::make_tuple(int(type), size, 0);
+        auto it = kempes.find(key);
+        if (it != kempes.end()) return it->second;
+        PhaseTimer phase("table load");
+        if (auto table = segment ? segment->Find(type, size, 0) : std::nullopt) {
+            return kempes[key] = *table;
+        }
+        if (auto table = FindInKempeStore(string("kempes/") + KempeFolderName(type) + ".bin", type, size, 0)) {
+            return kempes[key] = *table;
+        }
+        auto fileName = KempeFileName(size, type);
+        if (std::filesystem::exists(fileName)) {
+            return kempes[key] = KempeTable::FromStrings(LoadKempeTextFile(fileName));
+        }
+        spdlog::info("Kempe file {} not found, generating it", fileName);
+        auto generated = (type == Planar) ? GetPlanarKempes(size) : (type == Projective) ? GetProjectiveKempes(size) : (type == Apex) ? GetApexKempes(size) : GetToroidalKempes(size);
+        if (persist) {
+            std::filesystem::create_directories(std::filesystem::path(fileName).parent_path());
+            WriteKempeFile(fileName, generated);
+        }
+        return kempes[key] = KempeTable::FromStrings(generated);
+    }
+    // 左右のリングの大きさが leftSize, rightSize の annular な Kempe chain
+    const KempeTable& AnnularKempes(int leftSize, int rightSize) {
+        std::lock_guard lock(mtx);
+        auto key = std::make_tuple(int(annularKempeStoreType), leftSize, rightSize);
+        auto it = kempes.find(key);
+        if (it != kempes.end()) return it->second;
+        PhaseTimer phase("table load");
+        if (auto table = segment ? segment->Find(annularKempeStoreType, leftSize, rightSize) : std::nullopt) {
+            return kempes[key] = *table;
+        }
+        if (auto table = FindInKempeStore("kempes/annu.bin", annularKempeStoreType, leftSize, rightSize)) {
+            return kempes[key] = *table;
+        }
+        auto fileName = AnnularKempeFileName(leftSize, rightSize);
+        if (std::filesystem::exists(fileName)) {
+            return kempes[key] = KempeTable::FromStrings(LoadKempeTextFile(fileName));
+        }
+        spdlog::info("Kempe file {} not found, generating it", fileName);
+        auto generated = GetAnnularKempes(leftSize, rightSize);
+        if (persist) {
+            std::filesystem::create_directories(std::filesystem::path(fileName).parent_path());
+            WriteKempeFile(fileName, generated);
+        }
+        return kempes[key] = KempeTable::FromStrings(generated);
+    }
+};
+
+const ColoringTable& RingColorings(int size) {
+    return TableProvider::Instance().RingColorings(size);
+}
+
+const DihedralAction& RingAction(int size) {
+    return TableProvider::Instance().RingAction(size);
+}
+
+// Kempe change で固定する色を除いたリング (大きさ ringSize) 上の Kempe chain
+const KempeTable& KempesOfRing(int ringSize, KempeType type) {
+    return TableProvider::Instance().Kempes(ringSize / 2, type);
+}
+
+// annular の場合、片側のリングが空なら planar な Kempe chain を使う
+const KempeTable& KempesOfRing(pair<int, int> ring, KempeType) {
+    auto [l, r] = ring;
+    if (l == 0) return TableProvider::Instance().Kempes(r / 2, Planar);
+    if (r == 0) return TableProvider::Instance().Kempes(l / 2, Planar);
+    return TableProvider::Instance().AnnularKempes(l, r);
+}
+
+// KempesOfRing の表をリングの大きさごとに覚えておき、TableProvider の mutex を取るのを大きさごとに 1 回だけにする
+// (OneReduction の Coloring, fix ごとの参照に使う、1 つのスレッドからだけ使う)
+class RingKempeCache {
+    KempeType type;
+    vector<const KempeTable*> tables; // IndexOf(リングの大きさ) -> 表
+    static size_t IndexOf(int ringSize) {
+        return ringSize;
+    }
+    static size_t IndexOf(pair<int, int> ring) {
+        auto [l, r] = ring;
+        return size_t(l + r) * (l + r + 1) / 2 + r;
+    }
+public:
+    explicit RingKempeCache(KempeType type) : type(type) {}
+    template <typename RingType>
+    const KempeTable& Of(RingType ring) {
+        auto index = IndexOf(ring);
+        if (index >= tables.size()) tables.resize(index + 1, nullptr);
+        if (!tables[index]) tables[index] = &KempesOfRing(ring, type);
+        return *tables[index];
+    }
+};
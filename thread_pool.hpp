@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+// task(0), task(1), ..., task(taskNum - 1) を threadNum 個のスレッドで (添字の小さいものから順に取り出して) 実行する
+void RunInParallel(int taskNum, int threadNum, const std::function<void(int)>& task) {
+    threadNum = std::max(1, std::min(threadNum, taskNum));
+    std::atomic<int> next = 0;
+    auto work = [&] {
+        for (int i = next++; i < taskNum; i = next++) {
+            task(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < threadNum; t++) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// ハードウェアのスレッド数 (不明な場合は 1)
+int DefaultThreadNum() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
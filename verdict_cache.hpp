@@ -0,0 +1,76 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+#include <fmt/core.h>
+#include <fmt/ranges.h>
+
+using std::string;
+using std::vector;
+using std::optional;
+
+// 判定結果 (D-reducible / C-reducible / どちらでもない) を configuration の標準形ごとに保存するキャッシュ
+// 辺の番号の付け方やリングの始点・向きだけが異なる configuration は同じ標準形になるので、結果を使い回せる
+// ファイル <dir>/verdicts.txt に 1 行 1 件で追記する:
+//   <標準形のハッシュ値> <Kempe type> <cmin> <cmax> <D|C|N> <縮約する辺 (標準形での番号、カンマ区切り、なければ ->
+class VerdictCache {
+public:
+    struct Verdict {
+        char kind; // 'D': D-reducible, 'C': C-reducible, 'N': どちらでもない
+        vector<int> contraction; // 'C' の場合、縮約する辺 (標準形での番号)
+    };
+private:
+    using Key = std::tuple<uint64_t, string, int, int>;
+    string fileName;
+    std::map<Key, Verdict> entries;
+    std::mutex mtx;
+public:
+    explicit VerdictCache(const string& dir) : fileName(dir + "/verdicts.txt") {
+        std::filesystem::create_directories(dir);
+        std::ifstream ifs(fileName);
+        string line;
+        while (std::getline(ifs, line)) {
+            std::istringstream iss(line);
+            string hash, type, kind, edges;
+            int minCont, maxCont;
+            // 書き込み途中で終了した行は読み飛ばす
+            if (!(iss >> hash >> type >> minCont >> maxCont >> kind >> edges) || kind.size() != 1) continue;
+            Verdict verdict = {kind[0], {}};
+            if (edges != "-") {
+                std::istringstream edgeStream(edges);
+                string e;
+                while (std::getline(edgeStream, e, ',')) verdict.contraction.push_back(std::stoi(e));
+            }
+            entries[{std::stoull(hash, nullptr, 16), type, minCont, maxCont}] = verdict;
+        }
+        spdlog::debug("Loaded {} cached verdicts from {}", entries.size(), fileName);
+    }
+    optional<Verdict> Find(uint64_t hash, const string& type, int minCont, int maxCont) {
+        std::lock_guard lock(mtx);
+        auto it = entries.find({hash, type, minCont, maxCont});
+        if (it == entries.end()) return std::nullopt;
+        return it->second;
+    }
+    void Store(uint64_t hash, const string& type, int minCont, int maxCont, const Verdict& verdict) {
+        std::lock_guard lock(mtx);
+        if (!entries.emplace(Key{hash, type, minCont, maxCont}, verdict).second) return;
+        auto line = fmt::format("{:016x} {} {} {} {} {}\n", hash, type, minCont, maxCont, verdict.kind,
+            verdict.contraction.empty() ? string("-") : fmt::format("{}", fmt::join(verdict.contraction, ",")));
+        // 1 行を 1 回の write で追記する (O_APPEND なので他のプロセスと混ざらない)
+        int fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0 || ::write(fd, line.data(), line.size()) != (ssize_t)line.size()) {
+            spdlog::warn("Failed to append to verdict cache {}", fileName);
+        }
+        if (fd >= 0) ::close(fd);
+    }
+};